@@ -5,6 +5,8 @@
 
 #include "Graphs/SVFG.h"
 #include "SVF-LLVM/SVFIRBuilder.h"
+#include "SVFIRArtifact.h"
+#include <thread>
 
 using namespace SVF;
 using namespace llvm;
@@ -12,22 +14,8 @@ using namespace std;
 
 int main(int argc, char** argv)
 {
-    int arg_num = 0;
-    int extraArgc = 4;
-    char** arg_value = new char*[argc + extraArgc];
-    for (; arg_num < argc; ++arg_num) {
-        arg_value[arg_num] = argv[arg_num];
-    }
-    std::vector<std::string> moduleNameVec;
-
-    int orgArgNum = arg_num;
-    arg_value[arg_num++] = (char*)"-model-arrays=true";
-    arg_value[arg_num++] = (char*)"-pre-field-sensitive=false";
-    arg_value[arg_num++] = (char*)"-model-consts=true";
-    arg_value[arg_num++] = (char*)"-stat=false";
-    assert(arg_num == (orgArgNum + extraArgc) && "more extra arguments? Change the value of extraArgc");
-
-    moduleNameVec = OptionBase::parseOptions(arg_num, arg_value, "SVF IR", "[options] <input-bitcode...>");
+    std::vector<std::string> moduleNameVec =
+            SVFIRArtifact::parseOptions(argc, argv, "SVF IR", "[options] <input-bitcode...>");
 
     LLVMModuleSet::getLLVMModuleSet()->buildSVFModule(moduleNameVec);
 
@@ -35,10 +23,25 @@ int main(int argc, char** argv)
     SVFIRBuilder builder;
     cout << "Generating SVFIR(PAG), call graph and ICFG ..." << endl;
 
-    // TODO: here, generate SVFIR(PAG), call graph and ICFG, and dump them to files
-    //@{
-
-    //@}
-
-    return 0;
+    SVFIR *pag = builder.build();
+    auto callGraph = pag->getCallGraph();
+    ICFG *icfg = pag->getICFG();
+    std::string name = pag->getModuleIdentifier();
+
+    // <module>.svfir is what cfga (-cfga-artifact) and cflr (-cflr-artifact) load instead of building the
+    // module again. It is copied out of SVF here, so only writing it overlaps the dumps; the dumps themselves
+    // run one after the other, as SVF's graph writers are not known to be safe to run concurrently.
+    SVFIRArtifact artifact;
+    artifact.addPAG(pag);
+    artifact.addICFG(icfg);
+    bool saved = true;
+    std::thread saver([&]() { saved = artifact.save(name + ".svfir"); });
+
+    pag->dump(name + ".pag");
+    callGraph->dump(name + ".callgraph");
+    icfg->dump(name + ".icfg");
+    saver.join();
+
+    LLVMModuleSet::releaseLLVMModuleSet();
+    return saved ? 0 : 1;
 }
@@ -4,44 +4,114 @@
  */
 
 #include "CFGA.h"
+#include <memory>
 
 using namespace SVF;
 using namespace llvm;
 using namespace std;
 
+static const Option<u32_t> MaxPaths(
+        "cfga-max-paths", "Stop after this many paths (0 for no limit)", 0);
+static const Option<u32_t> MaxDepth(
+        "cfga-max-depth", "Longest path, in ICFG nodes, that is explored (0 for no limit)", 0);
+static const Option<bool> PruneSearch(
+        "cfga-prune", "Skip the branches that cannot reach a sink", true);
+static const Option<u32_t> SearchThreads(
+        "cfga-threads", "Threads of the path search (0 for one per hardware thread)", 1);
+static const Option<std::string> Queries(
+        "cfga-queries", "Queries answered in one run, \"sources->sinks\" separated by ';' (results in <module>.<i>.res.txt)", "");
+static const Option<std::string> OutputFormat(
+        "cfga-format", "Format of the paths (text, or delta for the binary <module>.res.bin)", "text");
+static const Option<bool> CompressOutput(
+        "cfga-gzip", "Compress the paths with gzip (.gz appended to the file name)", false);
+static const Option<bool> CountPaths(
+        "cfga-count", "Count the paths and summarise the nodes on them (<module>.sum.txt) instead of listing them", false);
+static const Option<u32_t> CountContext(
+        "cfga-count-context", "Call sites kept in the call strings of -cfga-count (0 for context-insensitive)", 3);
+static const Option<std::string> ArtifactFile(
+        "cfga-artifact", "Read the ICFG from an SVFIR artifact (<module>.svfir, written by svfir) instead of a module", "");
+static const Option<bool> StreamPaths(
+        "cfga-stream", "Write the paths as they are found, unsorted, instead of keeping them in memory", false);
+
+/// Answers the analyzer's current query into <module><suffix>.res.txt, or .sum.txt when counting
+static bool runQuery(CFGAnalysis &analyzer, const std::string &suffix)
+{
+    if (CountPaths())
+    {
+        analyzer.countPaths(CountContext());
+        return analyzer.dumpSummary(suffix);
+    }
+
+    PathWriter streamWriter(OutputFormat() == "delta" ? PathFormat::Delta : PathFormat::Text, CompressOutput());
+    if (StreamPaths())
+    {
+        if (!analyzer.openWriter(streamWriter, suffix))
+            return false;
+        analyzer.setPathCallback([&streamWriter](const std::vector<unsigned> &path) { streamWriter.write(path); });
+    }
+
+    analyzer.analyze();
+    if (analyzer.isTruncated())
+        std::cout << "path search stopped at a limit, the paths are incomplete\n";
+
+    if (StreamPaths())
+    {
+        analyzer.setPathCallback(nullptr);
+        return streamWriter.close();
+    }
+    return analyzer.dumpPaths(suffix);
+}
+
 int main(int argc, char **argv)
 {
     auto moduleNameVec =
-            OptionBase::parseOptions(argc, argv, "Whole Program Points-to Analysis",
-                                     "[options] <input-bitcode...>");
+            SVFIRArtifact::parseOptions(argc, argv, "Whole Program Points-to Analysis",
+                                        "[options] <input-bitcode...>");
 
-    LLVMModuleSet::buildSVFModule(moduleNameVec);
+    // With -cfga-artifact the ICFG comes from the file svfir wrote, and LLVM is never loaded
+    std::unique_ptr<CFGAnalysis> analysis;
+    bool moduleBuilt = ArtifactFile().empty();
+    if (moduleBuilt)
+    {
+        LLVMModuleSet::buildSVFModule(moduleNameVec);
 
-    SVFIRBuilder builder;
-    auto pag = builder.build();
-    auto icfg = pag->getICFG();
+        SVFIRBuilder builder;
+        auto pag = builder.build();
+        auto icfg = pag->getICFG();
 
-    CFGAnalysis analyzer = CFGAnalysis(icfg);
+        analysis.reset(new CFGAnalysis(icfg));
+    }
+    else
+    {
+        SVFIRArtifact artifact;
+        if (!artifact.load(ArtifactFile()))
+            return 1;
+        analysis.reset(new CFGAnalysis(artifact));
+    }
 
-    // TODO: complete the following method: 'CFGAnalysis::analyze'
-    analyzer.analyze(icfg);
+    CFGAnalysis &analyzer = *analysis;
+    analyzer.setLimits(MaxPaths(), MaxDepth());
+    analyzer.setThreads(SearchThreads());
+    analyzer.setPruning(PruneSearch());
+    if (OutputFormat() != "text" && OutputFormat() != "delta")
+    {
+        std::cout << "unknown path format " + OutputFormat() + "!!\n";
+        return 1;
+    }
+    analyzer.setOutput(OutputFormat() == "delta" ? PathFormat::Delta : PathFormat::Text, CompressOutput());
 
-    analyzer.dumpPaths();
-    LLVMModuleSet::releaseLLVMModuleSet();
-    return 0;
-}
+    // Without -cfga-queries the analyzer keeps main's entry and exit and writes <module>.res.txt
+    std::vector<CFGQuery> queries;
+    bool ok = analyzer.parseQueries(Queries(), queries);
+    if (ok && queries.empty())
+        ok = runQuery(analyzer, "");
+    for (size_t i = 0; ok && i < queries.size(); i++)
+    {
+        analyzer.setQuery(queries[i]);
+        ok = runQuery(analyzer, "." + std::to_string(i));
+    }
 
-
-void CFGAnalysis::analyze(SVF::ICFG *icfg)
-{
-    // Sources and sinks are specified when an analyzer is instantiated.
-    for (auto src : sources)
-        for (auto snk : sinks)
-        {
-            // TODO: DFS the graph, starting from src and detecting the paths ending at snk.
-            // Use the class method 'recordPath' (already defined) to record the path you detected.
-            //@{
-
-            //@}
-        }
+    if (moduleBuilt)
+        LLVMModuleSet::releaseLLVMModuleSet();
+    return ok ? 0 : 1;
 }
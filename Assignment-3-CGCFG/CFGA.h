@@ -1,6 +1,6 @@
 /**
  * ICFG.h
- * @author kisslune 
+ * @author kisslune
  */
 
 #ifndef ANSWERS_ICFG_H
@@ -8,21 +8,350 @@
 
 #include "Graphs/SVFG.h"
 #include "SVF-LLVM/SVFIRBuilder.h"
+#include "SVFIRArtifact.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * Paths sharing a prefix share its nodes, so a path costs one trie node per
+ * node it does not share with an earlier path.
+ */
+class PathTrie
+{
+public:
+    PathTrie();
+
+    /// Returns false if the path was already in the trie
+    bool insert(const std::vector<unsigned> &path);
+
+    bool contains(const std::vector<unsigned> &path) const;
+
+    void clear();
+
+    /// Number of distinct paths
+    inline size_t size() const
+    { return numPaths; }
+
+    /// Visits the paths in lexicographic order, the order of a std::set<std::vector<unsigned>>
+    void forEachPath(const std::function<void(const std::vector<unsigned> &)> &visit) const;
+
+private:
+    struct Node
+    {
+        unsigned label;
+        unsigned parent;
+        bool terminal;
+    };
+
+    std::vector<Node> nodes;                            // nodes[0] is the root
+    std::unordered_map<uint64_t, unsigned> children;    // (parent, label) -> child
+    size_t numPaths = 0;
+};
+
+
+/**
+ * The ICFG as flat arrays indexed by node id, which is all the analysis reads. It is copied from an
+ * SVF::ICFG, or loaded from an SVFIR artifact without LLVM.
+ */
+class FlatICFG
+{
+public:
+    typedef SVFIRArtifact::NodeKind NodeKind;
+    typedef SVFIRArtifact::EdgeKind EdgeKind;
+
+    /// An out-edge, where node is the destination, or an in-edge, where node is the source
+    struct Edge
+    {
+        unsigned node;
+        unsigned callSite;      ///< the call node of call and ret edges
+        EdgeKind kind;
+    };
+
+    explicit FlatICFG(SVF::ICFG *icfg);
+    explicit FlatICFG(const SVFIRArtifact &artifact);
+
+    /// Node ids in ascending order
+    inline const std::vector<unsigned> &getNodes() const
+    { return nodeIds; }
+
+    /// One more than the largest node id
+    inline unsigned getIdBound() const
+    { return kinds.size(); }
+
+    inline bool hasNode(unsigned id) const
+    { return id < kinds.size() && kinds[id] != NoNode; }
+
+    inline NodeKind getKind(unsigned id) const
+    { return (NodeKind) kinds[id]; }
+
+    inline const std::string &getFunName(unsigned id) const
+    { return funNames[funs[id]]; }
+
+    /// The call node of a FunRet node
+    inline unsigned getCallNode(unsigned id) const
+    { return callNodes[id]; }
+
+    inline const Edge *outBegin(unsigned id) const
+    { return outEdges.data() + outOffsets[id]; }
+
+    inline const Edge *outEnd(unsigned id) const
+    { return outEdges.data() + outOffsets[id + 1]; }
+
+    inline const Edge *inBegin(unsigned id) const
+    { return inEdges.data() + inOffsets[id]; }
+
+    inline const Edge *inEnd(unsigned id) const
+    { return inEdges.data() + inOffsets[id + 1]; }
+
+private:
+    void build(const SVFIRArtifact &artifact);
+
+    static constexpr uint8_t NoNode = 0xff;
+
+    std::vector<unsigned> nodeIds;
+    std::vector<uint8_t> kinds;
+    std::vector<unsigned> funs;
+    std::vector<unsigned> callNodes;
+    std::vector<std::string> funNames;
+    std::vector<unsigned> outOffsets, inOffsets;
+    std::vector<Edge> outEdges, inEdges;
+};
+
+
+/**
+ * Call stacks of the path search, interned: an id names the innermost call site and the
+ * context it was called from. Context 0 is the empty stack.
+ */
+class CallContexts
+{
+public:
+    CallContexts();
+
+    /// Context reached over the edge from ctx; false if the edge returns to another call site or re-enters a call site
+    bool successor(const FlatICFG::Edge &edge, unsigned ctx, unsigned &succ);
+
+    inline unsigned callSiteOf(unsigned ctx) const
+    { return callStack[ctx].callSite; }
+
+    inline unsigned parentOf(unsigned ctx) const
+    { return callStack[ctx].parent; }
+
+private:
+    unsigned push(unsigned ctx, unsigned callSite);
+
+    struct CallFrame
+    {
+        unsigned parent;
+        unsigned callSite;
+    };
+    std::vector<CallFrame> callStack;
+    std::unordered_map<uint64_t, unsigned> contextIds;
+};
+
+
+/**
+ * Which ICFG nodes can still reach a sink, from per-function summaries computed backwards from the sinks.
+ * It over-approximates the paths the search follows, so a node it rejects is a dead branch.
+ */
+class SinkIndex
+{
+public:
+    void build(const FlatICFG &graph, const std::set<unsigned> &sinks);
+
+    /// Whether a sink is reachable from node under the call stack ctx; memo caches the answer per context
+    bool canReach(unsigned node, unsigned ctx, const CallContexts &contexts, std::vector<signed char> &memo) const;
+
+private:
+    std::vector<bool> reachesExit;  // reaches the exit of its function through balanced calls
+    std::vector<bool> reachesBelow; // reaches a sink in its function or in a callee, without returning
+    std::vector<bool> reachesAny;   // reaches a sink under the empty call stack, returning to any caller
+    std::unordered_map<unsigned, unsigned> retOfCall;
+};
+
+
+enum class PathFormat
+{
+    Text,   ///< "n, n, ..., \n" per path, the format of <module>.res.txt
+    Delta   ///< binary, see PathWriter
+};
+
+/**
+ * Buffered path output, optionally gzip-compressed.
+ * The Delta format starts with "CFGP" and a version byte; each path is then the varint length of the
+ * prefix it shares with the previous path, the varint number of remaining nodes, and those nodes as
+ * zigzag varint differences from the node before them (0 before the first one).
+ */
+class PathWriter
+{
+public:
+    PathWriter(PathFormat format, bool compress);
+    PathWriter(const PathWriter &) = delete;
+    PathWriter &operator=(const PathWriter &) = delete;
+    ~PathWriter();
+
+    bool open(const std::string &fname);
+    void write(const std::vector<unsigned> &path);
+    /// @return false if any write or the close failed, which is also reported
+    bool close();
+
+private:
+    void put(const char *data, size_t len);
+    void putVarint(uint64_t value);
+    void flush();
+
+    PathFormat format;
+    bool compress;
+    FILE *file = nullptr;
+    void *gz = nullptr;     // gzFile, when compressing
+    std::string fileName;
+    bool failed = false;    // a write since open() failed
+    std::vector<char> buffer;
+    size_t used = 0;
+    std::vector<unsigned> previous;
+};
+
+
+/// One reachability question: the paths from any of the sources to any of the sinks
+struct CFGQuery
+{
+    std::set<unsigned> sources;
+    std::set<unsigned> sinks;
+};
+
 
 class CFGAnalysis
 {
 public:
+    typedef std::function<void(const std::vector<unsigned> &)> PathCallback;
+
+    /// Sources and sinks default to the entry and the exit of main
     explicit CFGAnalysis(SVF::ICFG *icfg);
+    explicit CFGAnalysis(const SVFIRArtifact &artifact);
+    void analyze();
+    /// Analyzes the ICFG this analyzer was built from; kept for callers of the original interface
     void analyze(SVF::ICFG *icfg);
-    void dumpPaths();
+    /// @return false if the result file could not be written
+    bool dumpPaths(const std::string &suffix = "");
+
+    /**
+     * Counts the paths by dynamic programming over (node, call string) states instead of enumerating them.
+     * Call strings keep the innermost k call sites (k = 0: context-insensitive) and edges closing a cycle
+     * are skipped, so the count is exact on acyclic ICFGs whose calls nest at most k deep.
+     */
+    void countPaths(unsigned k);
+
+    /// Writes the path count and the nodes on any counted path to <module><suffix>.sum.txt; false if it fails
+    bool dumpSummary(const std::string &suffix = "");
+
+    /// Format of dumpPaths() and of streamed paths; the text format is the default
+    inline void setOutput(PathFormat format, bool compress)
+    {
+        outputFormat = format;
+        compressOutput = compress;
+    }
+
+    /// Opens <module><suffix>.res.txt, or .res.bin for the Delta format, with .gz appended when compressing
+    bool openWriter(PathWriter &writer, const std::string &suffix = "") const;
+
+    /// Replaces the sources and sinks and forgets the paths found so far
+    void setQuery(const CFGQuery &query);
+
+    /**
+     * Parses queries separated by ';', each "sources->sinks" with comma-separated node specs:
+     * an ICFG node id, entry:F, exit:F, call:F (the call sites of F), ret:F (their return sites),
+     * or a bare function name, standing for its entry among the sources and its exit among the sinks.
+     */
+    bool parseQueries(const std::string &text, std::vector<CFGQuery> &queries) const;
+
+    /// Paths with more than maxDepth nodes are cut, and the search stops after maxPaths paths (0 = unlimited)
+    inline void setLimits(unsigned paths, unsigned depth)
+    {
+        maxPaths = paths;
+        maxDepth = depth;
+    }
+
+    /// Cuts branches that cannot reach a sink (on by default); the paths do not depend on it
+    inline void setPruning(bool prune)
+    { pruning = prune; }
+
+    /// Searches with this many threads (0 = one per hardware thread); the paths and their order do not depend on it
+    inline void setThreads(unsigned threads)
+    { numThreads = threads; }
+
+    /// Hands every path to the callback as it is found instead of keeping it for dumpPaths()
+    inline void setPathCallback(PathCallback callback)
+    { pathCallback = std::move(callback); }
+
+    /// Whether a limit cut the search short
+    inline bool isTruncated() const
+    { return truncated; }
+
+    /// Opens <module><suffix><ext>
+    bool openResult(std::ofstream &outFile, const std::string &suffix = "", const std::string &ext = ".res.txt") const;
 
 protected:
+    /// Keeps a path; once maxPaths paths are kept, a further distinct path only marks the search as truncated
     void recordPath(const std::vector<unsigned> &path);
 
-    std::stack<unsigned> callStack;
+    void selectMain();
+    bool resolveNodes(const std::string &spec, bool source, std::set<unsigned> &nodes) const;
+
+    inline bool limitReached() const
+    { return maxPaths != 0 && numPaths >= maxPaths; }
+
+    struct Step
+    {
+        unsigned node;
+        unsigned ctx;
+    };
+
+    /// A path found while splitting the search, or (open) a prefix whose extensions are still to be searched
+    struct SearchItem
+    {
+        std::vector<Step> prefix;
+        bool open;
+    };
+
+    /// Replaces an open item by the paths and open prefixes one edge longer, in DFS order
+    void expand(const SearchItem &item, CallContexts &contexts, std::vector<SearchItem> &out, bool &cut) const;
+
+    inline bool isLive(unsigned node, unsigned ctx, const CallContexts &contexts, std::vector<signed char> &memo) const
+    { return !pruning || sinkIndex.canReach(node, ctx, contexts, memo); }
+
+    /// DFS below an open prefix; hands at most budget (0 = unlimited) paths to record and returns their number
+    size_t search(const std::vector<Step> &prefix, CallContexts &contexts, const PathCallback &record,
+                  size_t budget, bool &cut) const;
+
+    static inline uint64_t pathKey(unsigned node, unsigned ctx)
+    { return (uint64_t) node << 32 | ctx; }
+
+    FlatICFG graph;
+    std::string moduleName;     // names the result files
+    CallContexts callStack;
+
     std::set<unsigned> sources;
     std::set<unsigned> sinks;
-    std::set<std::vector<unsigned>> reachablePaths;
+    SinkIndex sinkIndex;
+    PathTrie reachablePaths;
+    PathCallback pathCallback;
+
+    PathFormat outputFormat = PathFormat::Text;
+    bool compressOutput = false;
+
+    uint64_t pathCount = 0;
+    bool countSaturated = false;
+    std::vector<unsigned> coverage;
+
+    unsigned maxPaths = 0;
+    unsigned maxDepth = 0;
+    unsigned numThreads = 1;
+    bool pruning = true;
+    size_t numPaths = 0;
+    bool truncated = false;
 };
 
 #endif //ANSWERS_ICFG_H
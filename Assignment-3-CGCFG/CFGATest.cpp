@@ -0,0 +1,683 @@
+/**
+ * CFGATest.cpp
+ * Checks the path search and its data structures on ICFGs built in memory.  Run by ctest.
+ *
+ * usage: cfga-test
+ * @author kisslune
+ */
+
+#include "CFGA.h"
+
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#ifdef CFGA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+
+unsigned failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        ++failures;
+        std::cout << "FAIL: " << what << "\n";
+    }
+}
+
+/// PathTrie against a std::set of paths: insertions, lookups and the visiting order
+void checkPathTrie()
+{
+    std::mt19937 rng(3);
+    PathTrie trie;
+    std::set<std::vector<unsigned>> expected;
+    bool ok = true;
+    for (unsigned i = 0; i < 5000 && ok; ++i)
+    {
+        std::vector<unsigned> path(1 + rng() % 6);
+        for (unsigned &node : path)
+            node = rng() % 5;
+        bool present = expected.count(path) != 0;
+        ok = trie.contains(path) == present && trie.insert(path) == !present && trie.contains(path);
+        expected.insert(path);
+    }
+    check(ok, "PathTrie insert and contains against a set");
+    check(trie.size() == expected.size(), "PathTrie size");
+
+    std::vector<std::vector<unsigned>> visited;
+    trie.forEachPath([&visited](const std::vector<unsigned> &path) { visited.push_back(path); });
+    check(visited == std::vector<std::vector<unsigned>>(expected.begin(), expected.end()), "PathTrie order");
+
+    trie.clear();
+    check(trie.size() == 0 && !trie.contains(*expected.begin()), "PathTrie clear");
+}
+
+/// main: entry, then a chain of diamonds, then exit; 2^diamonds paths from the entry to the exit
+SVFIRArtifact diamonds(unsigned count)
+{
+    SVFIRArtifact artifact;
+    artifact.module = "cfga-test";
+    artifact.funs.push_back("main");
+    unsigned exit = 3 * count + 1;
+    for (unsigned id = 0; id <= exit; ++id)
+    {
+        SVFIRArtifact::NodeKind kind = id == 0 ? SVFIRArtifact::FunEntry :
+                                       id == exit ? SVFIRArtifact::FunExit : SVFIRArtifact::Intra;
+        artifact.nodes.push_back({id, kind, 0, 0});
+    }
+    unsigned top = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned left = 3 * i + 1, right = 3 * i + 2, join = 3 * i + 3;
+        artifact.edges.push_back({SVFIRArtifact::IntraCF, top, left});
+        artifact.edges.push_back({SVFIRArtifact::IntraCF, top, right});
+        artifact.edges.push_back({SVFIRArtifact::IntraCF, left, join});
+        artifact.edges.push_back({SVFIRArtifact::IntraCF, right, join});
+        top = join;
+    }
+    artifact.edges.push_back({SVFIRArtifact::IntraCF, top, exit});
+    return artifact;
+}
+
+/// The number of lines of a file
+size_t countLines(const std::string &fileName)
+{
+    std::ifstream inFile(fileName);
+    size_t lines = 0;
+    for (std::string line; std::getline(inFile, line);)
+        ++lines;
+    return lines;
+}
+
+/// A search that stops at maxPaths is truncated only if more paths exist, streamed or kept in the trie
+void checkPathLimit()
+{
+    const unsigned Diamonds = 3;
+    const unsigned AllPaths = 1 << Diamonds;
+    SVFIRArtifact artifact = diamonds(Diamonds);
+    for (unsigned maxPaths : {0u, AllPaths - 1, AllPaths, AllPaths + 1})
+        for (unsigned threads : {1u, 4u})
+            for (bool stream : {true, false})
+            {
+                std::string name = "maxPaths " + std::to_string(maxPaths) + ", " + std::to_string(threads) +
+                                   " threads" + (stream ? ", streamed" : "");
+                CFGAnalysis analyzer(artifact);
+                analyzer.setLimits(maxPaths, 0);
+                analyzer.setThreads(threads);
+                size_t found = 0;
+                if (stream)
+                    analyzer.setPathCallback([&found](const std::vector<unsigned> &) { ++found; });
+                analyzer.analyze();
+                if (!stream)
+                {
+                    analyzer.dumpPaths();
+                    found = countLines("cfga-test.res.txt");
+                    std::remove("cfga-test.res.txt");
+                }
+
+                unsigned expected = maxPaths != 0 && maxPaths < AllPaths ? maxPaths : AllPaths;
+                check(found == expected, name + ": " + std::to_string(found) + " paths");
+                check(analyzer.isTruncated() == (expected < AllPaths), name + ": truncation");
+            }
+}
+
+/// Node ids in queries: in range, beyond any node, beyond unsigned, and a spec with a non-ASCII byte
+void checkQueryParsing()
+{
+    SVFIRArtifact artifact = diamonds(1);
+    CFGAnalysis analyzer(artifact);
+    std::vector<CFGQuery> queries;
+    check(analyzer.parseQueries(" 0 -> 4 ; main->main", queries) && queries.size() == 2 &&
+          queries[0].sources == std::set<unsigned>{0} && queries[0].sinks == std::set<unsigned>{4} &&
+          queries[1].sources == queries[0].sources && queries[1].sinks == queries[0].sinks, "parsing node queries");
+    check(!analyzer.parseQueries("0->5", queries), "rejecting a node beyond the ICFG");
+    check(!analyzer.parseQueries("0->99999999999999999999", queries), "rejecting a node beyond unsigned");
+    check(!analyzer.parseQueries("0->4\xe9", queries), "rejecting a non-ASCII node spec");
+}
+
+/// Artifacts whose statements, edges or return nodes refer to missing nodes, or whose records are malformed,
+/// fail to load; in memory, the edges to missing nodes are dropped
+void checkArtifactIds()
+{
+    const std::string fileName = "cfga-test.artifact";
+    SVFIRArtifact artifact = diamonds(1);
+    artifact.numPAGNodes = 2;
+    artifact.stmts.push_back({SVFIRArtifact::Copy, 0, 1, 0});
+    SVFIRArtifact loaded;
+    check(artifact.save(fileName) && loaded.load(fileName) && loaded.edges.size() == artifact.edges.size(),
+          "loading a well-formed artifact");
+
+    auto rejected = [&fileName](const SVFIRArtifact &bad) {
+        SVFIRArtifact reloaded;
+        return bad.save(fileName) && !reloaded.load(fileName);
+    };
+    SVFIRArtifact bad = artifact;
+    bad.stmts.push_back({SVFIRArtifact::Copy, 0, 2, 0});
+    check(rejected(bad), "rejecting a statement beyond the PAG");
+    bad = artifact;
+    bad.edges.push_back({SVFIRArtifact::IntraCF, 4, 5});
+    check(rejected(bad), "rejecting an edge to a missing node");
+    bad = artifact;
+    bad.nodes.push_back({6, SVFIRArtifact::FunRet, 0, 5});
+    check(rejected(bad), "rejecting a return node without its call node");
+
+    // Written by hand: records out of order, and gep fields
+    auto loads = [&fileName](const std::string &records) {
+        std::ofstream(fileName) << "svfir-artifact 1\n" << records;
+        SVFIRArtifact reloaded;
+        return reloaded.load(fileName);
+    };
+    check(loads("node 0 entry 0\nedge intra 0 1\nnode 1 exit 0\nfun 0 main\ngep 1 0 *\ngep 0 1 3\npag 2\n"),
+          "loading records in any order");
+    check(!loads("fun 0 main\nnode 0 entry 1\n"), "rejecting a node in a missing function");
+    check(!loads("pag 2\ngep 0 1 abc\n"), "rejecting a gep field that is not a number");
+    check(!loads("pag 2\ngep 0 1 3x\n"), "rejecting a gep field with trailing characters");
+    std::remove(fileName.c_str());
+
+    bad = artifact;
+    bad.edges.push_back({SVFIRArtifact::IntraCF, 4, 5});
+    bad.edges.push_back({SVFIRArtifact::IntraCF, 1000000000, 0});
+    CFGAnalysis analyzer(bad);
+    analyzer.setLimits(0, 0);
+    size_t found = 0;
+    analyzer.setPathCallback([&found](const std::vector<unsigned> &) { ++found; });
+    analyzer.analyze();
+    check(found == 2, "dropping edges to missing nodes");
+}
+
+/// The bytes of a file, decompressed if gzipped
+std::string readFile(const std::string &fileName, bool compressed)
+{
+    std::string bytes;
+    if (!compressed)
+    {
+        std::ifstream inFile(fileName, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+        return bytes;
+    }
+#ifdef CFGA_HAVE_ZLIB
+    gzFile gz = gzopen(fileName.c_str(), "rb");
+    char chunk[1 << 16];
+    for (int len; gz && (len = gzread(gz, chunk, sizeof(chunk))) > 0;)
+        bytes.append(chunk, len);
+    if (gz)
+        gzclose(gz);
+#endif
+    return bytes;
+}
+
+/// Paths of the Text format
+std::vector<std::vector<unsigned>> parseText(const std::string &bytes)
+{
+    std::vector<std::vector<unsigned>> paths;
+    std::istringstream lines(bytes);
+    for (std::string line; std::getline(lines, line);)
+    {
+        paths.emplace_back();
+        std::istringstream nodes(line);
+        for (std::string node; std::getline(nodes, node, ',');)
+            if (node != " ")
+                paths.back().push_back((unsigned) std::stoul(node));
+    }
+    return paths;
+}
+
+/// Paths of the Delta format, false if the bytes are not well-formed
+bool parseDelta(const std::string &bytes, std::vector<std::vector<unsigned>> &paths)
+{
+    if (bytes.compare(0, 5, "CFGP\1", 5) != 0)
+        return false;
+    size_t pos = 5;
+    auto varint = [&](uint64_t &value) {
+        value = 0;
+        for (unsigned shift = 0; pos < bytes.size() && shift < 64; shift += 7)
+        {
+            uint8_t byte = bytes[pos++];
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    };
+    std::vector<unsigned> previous;
+    while (pos < bytes.size())
+    {
+        uint64_t shared, rest;
+        if (!varint(shared) || !varint(rest) || shared > previous.size())
+            return false;
+        std::vector<unsigned> path(previous.begin(), previous.begin() + shared);
+        int64_t last = shared == 0 ? 0 : path.back();
+        for (uint64_t i = 0; i < rest; ++i)
+        {
+            uint64_t zigzag;
+            if (!varint(zigzag))
+                return false;
+            last += (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+            path.push_back((unsigned) last);
+        }
+        paths.push_back(path);
+        previous = path;
+    }
+    return true;
+}
+
+/// PathWriter output of every format, with and without gzip, read back.  The paths are sorted with long
+/// shared prefixes and extreme node ids, and outgrow the write buffer several times.
+void checkPathWriter()
+{
+    std::mt19937 rng(11);
+    std::set<std::vector<unsigned>> sorted;
+    std::vector<unsigned> path;
+    while (sorted.size() < 40000)
+    {
+        path.resize(rng() % (path.size() + 1));
+        for (unsigned extra = 1 + rng() % 8; extra > 0; --extra)
+            path.push_back(rng() % 4 == 0 ? (rng() % 2 ? 0 : ~0u) : rng() % 100000);
+        sorted.insert(path);
+    }
+    std::vector<std::vector<unsigned>> paths(sorted.begin(), sorted.end());
+
+    for (PathFormat format : {PathFormat::Text, PathFormat::Delta})
+        for (bool compress : {false, true})
+        {
+            std::string name = std::string(format == PathFormat::Text ? "text" : "delta") + (compress ? "/gzip" : "");
+            std::string fileName = "cfga-test.paths";
+            PathWriter writer(format, compress);
+#ifndef CFGA_HAVE_ZLIB
+            if (compress)
+            {
+                check(!writer.open(fileName), name + ": rejected without zlib");
+                continue;
+            }
+#endif
+            bool written = writer.open(fileName);
+            for (const std::vector<unsigned> &p : paths)
+                writer.write(p);
+            written = writer.close() && written;
+            check(written, name + ": writing");
+
+            std::string bytes = readFile(fileName, compress);
+            std::vector<std::vector<unsigned>> read;
+            if (format == PathFormat::Text)
+                read = parseText(bytes);
+            else
+                check(parseDelta(bytes, read), name + ": well-formed");
+            check(read == paths, name + ": round trip");
+            std::remove(fileName.c_str());
+
+            // A device that is always full fails the writes, which close() must not lose
+            if (std::FILE *full = std::fopen("/dev/full", "wb"))
+            {
+                std::fclose(full);
+                PathWriter failing(format, compress);
+                bool opened = failing.open("/dev/full");
+                for (const std::vector<unsigned> &p : paths)
+                    failing.write(p);
+                check(opened && !failing.close(), name + ": reporting a failed write");
+            }
+        }
+}
+
+/// What a random program exercises
+struct Features
+{
+    bool indirectCall = false;  ///< a call site with two callees
+    bool recursion = false;     ///< a function calling itself
+    bool loop = false;          ///< an intra-procedural back edge
+};
+
+/**
+ * A random program of four functions, function 0 being main. A function is a chain of units from its entry to its
+ * exit, with forward branches; a unit is an intra node, or a call site made of its call and return nodes. A call
+ * site calls one function, or two as an indirect call. Cyclic programs add back edges and may call any function,
+ * acyclic ones only call functions of a higher index, so that calls nest at most three deep.
+ */
+SVFIRArtifact randomProgram(unsigned seed, bool acyclic, Features &features)
+{
+    const unsigned NumFuns = 4;
+    std::mt19937 rng(seed);
+    SVFIRArtifact artifact;
+    artifact.module = "cfga-test";
+    auto addNode = [&artifact](SVFIRArtifact::NodeKind kind, unsigned fun, unsigned callNode) {
+        unsigned id = artifact.nodes.size();
+        artifact.nodes.push_back({id, kind, fun, callNode});
+        return id;
+    };
+    auto addEdge = [&artifact](SVFIRArtifact::EdgeKind kind, unsigned src, unsigned dst) {
+        artifact.edges.push_back({kind, src, dst});
+    };
+
+    // The first and the last node of each unit, and the call sites with their callers
+    std::vector<std::vector<std::pair<unsigned, unsigned>>> units(NumFuns);
+    std::vector<std::pair<unsigned, unsigned>> callSites;
+    std::vector<unsigned> entries, exits;
+    for (unsigned f = 0; f < NumFuns; ++f)
+    {
+        artifact.funs.push_back(f == 0 ? "main" : "f" + std::to_string(f));
+        entries.push_back(addNode(SVFIRArtifact::FunEntry, f, 0));
+        units[f].push_back({entries[f], entries[f]});
+        for (unsigned u = 3 + rng() % 2; u > 0; --u)
+        {
+            if (rng() % 2 == 0 && !(acyclic && f + 1 == NumFuns))
+            {
+                unsigned call = addNode(SVFIRArtifact::FunCall, f, 0);
+                units[f].push_back({call, addNode(SVFIRArtifact::FunRet, f, call)});
+                callSites.push_back({call, f});
+            }
+            else
+            {
+                unsigned node = addNode(SVFIRArtifact::Intra, f, 0);
+                units[f].push_back({node, node});
+            }
+        }
+        exits.push_back(addNode(SVFIRArtifact::FunExit, f, 0));
+        units[f].push_back({exits[f], exits[f]});
+    }
+
+    for (unsigned f = 0; f < NumFuns; ++f)
+        for (size_t i = 0; i + 1 < units[f].size(); ++i)
+        {
+            unsigned last = units[f][i].second;
+            addEdge(SVFIRArtifact::IntraCF, last, units[f][i + 1].first);
+            if (i + 2 < units[f].size() && rng() % 3 == 0)
+                addEdge(SVFIRArtifact::IntraCF, last, units[f][i + 2].first);
+            if (!acyclic && i > 0 && rng() % 4 == 0)
+            {
+                addEdge(SVFIRArtifact::IntraCF, last, units[f][rng() % (i + 1)].first);
+                features.loop = true;
+            }
+        }
+    for (auto &site : callSites)
+    {
+        unsigned call = site.first, caller = site.second;
+        auto pick = [&]() -> unsigned {
+            return acyclic ? caller + 1 + rng() % (NumFuns - caller - 1) : rng() % NumFuns;
+        };
+        std::vector<unsigned> callees{pick()};
+        unsigned second = pick();
+        if (rng() % 3 == 0 && second != callees[0])
+            callees.push_back(second);
+        features.indirectCall |= callees.size() > 1;
+        for (unsigned callee : callees)
+        {
+            features.recursion |= callee == caller;
+            addEdge(SVFIRArtifact::CallCF, call, entries[callee]);
+            addEdge(SVFIRArtifact::RetCF, exits[callee], call + 1);
+        }
+    }
+    return artifact;
+}
+
+/// The entry of main to its exit, and one with the other functions' entries as sources, whose paths return to
+/// callers they were not called from, and two random nodes among the sinks
+std::vector<CFGQuery> queriesOf(const SVFIRArtifact &artifact, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    CFGQuery fromMain, fromCallees;
+    for (auto &node : artifact.nodes)
+    {
+        if (node.kind == SVFIRArtifact::FunEntry)
+            (node.fun == 0 ? fromMain.sources : fromCallees.sources).insert(node.id);
+        if (node.kind == SVFIRArtifact::FunExit && node.fun == 0)
+            fromMain.sinks.insert(node.id);
+    }
+    fromCallees.sinks = fromMain.sinks;
+    fromCallees.sinks.insert(rng() % artifact.nodes.size());
+    fromCallees.sinks.insert(rng() % artifact.nodes.size());
+    return {fromMain, fromCallees};
+}
+
+/**
+ * The paths of a query in the order the search finds them, by a plain recursive DFS over explicit call stacks:
+ * a call edge pushes its call site unless it is on the stack already, a return edge pops the call site of its
+ * return node, or goes to any caller from the empty stack. Stops after limit paths, and cuts paths at maxDepth nodes.
+ */
+class ReferenceSearch
+{
+public:
+    ReferenceSearch(const SVFIRArtifact &artifact, const CFGQuery &query, unsigned maxDepth, size_t limit)
+            : sinks(query.sinks), maxDepth(maxDepth), limit(limit)
+    {
+        for (auto &edge : artifact.edges)
+            out[edge.src].push_back(edge);
+        for (auto &node : artifact.nodes)
+            callNodes[node.id] = node.callNode;
+        for (unsigned src : query.sources)
+        {
+            std::vector<unsigned> stack;
+            path.assign(1, src);
+            onPath.insert({src, stack});
+            if (sinks.count(src))
+                record();
+            visit(src, stack);
+            onPath.clear();
+        }
+    }
+
+    std::vector<std::vector<unsigned>> paths;
+    bool overflow = false;     ///< whether more than limit paths exist
+
+private:
+    void record()
+    {
+        if (paths.size() < limit)
+            paths.push_back(path);
+        else
+            overflow = true;
+    }
+
+    void visit(unsigned node, const std::vector<unsigned> &stack)
+    {
+        for (auto &edge : out[node])
+        {
+            if (overflow || (maxDepth != 0 && path.size() >= maxDepth))
+                return;
+            std::vector<unsigned> next = stack;
+            if (edge.kind == SVFIRArtifact::CallCF)
+            {
+                if (std::find(stack.begin(), stack.end(), edge.src) != stack.end())
+                    continue;
+                next.push_back(edge.src);
+            }
+            else if (edge.kind == SVFIRArtifact::RetCF && !stack.empty())
+            {
+                if (stack.back() != callNodes[edge.dst])
+                    continue;
+                next.pop_back();
+            }
+            if (!onPath.insert({edge.dst, next}).second)
+                continue;
+            path.push_back(edge.dst);
+            if (sinks.count(edge.dst))
+                record();
+            visit(edge.dst, next);
+            path.pop_back();
+            onPath.erase({edge.dst, next});
+        }
+    }
+
+    std::map<unsigned, std::vector<SVFIRArtifact::Edge>> out;
+    std::map<unsigned, unsigned> callNodes;
+    std::set<unsigned> sinks;
+    unsigned maxDepth;
+    size_t limit;
+    std::vector<unsigned> path;
+    std::set<std::pair<unsigned, std::vector<unsigned>>> onPath;
+};
+
+/// The paths an analyzer streams, in order, and whether it reports truncation
+struct SearchResult
+{
+    std::vector<std::vector<unsigned>> paths;
+    bool truncated;
+
+    bool operator==(const SearchResult &other) const
+    { return paths == other.paths && truncated == other.truncated; }
+};
+
+SearchResult searchPaths(const SVFIRArtifact &artifact, const CFGQuery &query, unsigned maxPaths, unsigned maxDepth,
+                         unsigned threads, bool pruning)
+{
+    CFGAnalysis analyzer(artifact);
+    analyzer.setQuery(query);
+    analyzer.setLimits(maxPaths, maxDepth);
+    analyzer.setThreads(threads);
+    analyzer.setPruning(pruning);
+    SearchResult result;
+    analyzer.setPathCallback([&result](const std::vector<unsigned> &path) { result.paths.push_back(path); });
+    analyzer.analyze();
+    result.truncated = analyzer.isTruncated();
+    return result;
+}
+
+/// Random programs with their queries, whose paths the reference search finds in full
+struct Fixture
+{
+    std::string name;
+    SVFIRArtifact artifact;
+    CFGQuery query;
+    std::vector<std::vector<unsigned>> paths;
+};
+
+std::vector<Fixture> fixtures(bool acyclic)
+{
+    const size_t MaxPaths = 5000;
+    std::vector<Fixture> all;
+    Features features;
+    for (unsigned seed = 1; seed <= 40; ++seed)
+    {
+        SVFIRArtifact artifact = randomProgram(seed, acyclic, features);
+        std::vector<CFGQuery> queries = queriesOf(artifact, seed);
+        for (size_t q = 0; q < queries.size(); ++q)
+        {
+            ReferenceSearch reference(artifact, queries[q], 0, MaxPaths);
+            if (!reference.overflow)
+                all.push_back({std::string(acyclic ? "acyclic " : "program ") + std::to_string(seed) + ", query " +
+                               std::to_string(q), artifact, queries[q], reference.paths});
+        }
+    }
+    check(all.size() >= 40, std::string(acyclic ? "acyclic" : "cyclic") + " fixtures with few enough paths");
+    if (!acyclic)
+        check(features.indirectCall && features.recursion && features.loop,
+              "fixtures with indirect calls, recursion and loops");
+    return all;
+}
+
+/// The search against the reference DFS, on ICFGs with calls, indirect calls, recursion and loops: the streamed
+/// paths in order, and the paths kept for dumpPaths, which come out sorted and without duplicates
+void checkCallPaths(const std::vector<Fixture> &programs)
+{
+    size_t nonEmpty = 0;
+    for (const Fixture &fixture : programs)
+    {
+        nonEmpty += !fixture.paths.empty();
+        SearchResult streamed = searchPaths(fixture.artifact, fixture.query, 0, 0, 1, true);
+        check(streamed == SearchResult{fixture.paths, false}, fixture.name + ": streamed paths");
+
+        CFGAnalysis analyzer(fixture.artifact);
+        analyzer.setQuery(fixture.query);
+        analyzer.analyze();
+        analyzer.dumpPaths();
+        std::set<std::vector<unsigned>> expected(fixture.paths.begin(), fixture.paths.end());
+        std::vector<std::vector<unsigned>> kept = parseText(readFile("cfga-test.res.txt", false));
+        check(kept == std::vector<std::vector<unsigned>>(expected.begin(), expected.end()), fixture.name + ": kept paths");
+        std::remove("cfga-test.res.txt");
+    }
+    check(nonEmpty >= programs.size() / 2, "fixtures with paths");
+}
+
+/// Under max-paths and max-depth limits, on ICFGs with calls: 4 threads stream the paths of 1 thread, in the same
+/// order, and report truncation alike; the paths are the first ones of the reference DFS with the same depth limit
+void checkThreadLimits(const std::vector<Fixture> &programs)
+{
+    for (const Fixture &fixture : programs)
+    {
+        unsigned all = fixture.paths.size();
+        std::set<unsigned> limits{0, 1, all / 2, all == 0 ? 0 : all - 1, all, all + 1};
+        for (unsigned maxPaths : limits)
+            for (unsigned maxDepth : {0u, 5u, 40u})
+            {
+                std::string name = fixture.name + ", maxPaths " + std::to_string(maxPaths) + ", maxDepth " +
+                                   std::to_string(maxDepth);
+                SearchResult serial = searchPaths(fixture.artifact, fixture.query, maxPaths, maxDepth, 1, true);
+                SearchResult parallel = searchPaths(fixture.artifact, fixture.query, maxPaths, maxDepth, 4, true);
+                check(parallel == serial, name + ": 4 threads against 1");
+
+                ReferenceSearch reference(fixture.artifact, fixture.query, maxDepth, maxPaths == 0 ? all + 1 : maxPaths);
+                check(serial.paths == reference.paths, name + ": paths");
+                if (maxDepth == 0)
+                    check(serial.truncated == reference.overflow, name + ": truncation");
+            }
+    }
+}
+
+/// Pruning cuts dead branches only: the same paths in the same order with it and without it, also under a depth
+/// limit, on ICFGs with calls and with returns to callers a path was not called from
+void checkPruning(const std::vector<Fixture> &programs)
+{
+    for (const Fixture &fixture : programs)
+        for (unsigned maxDepth : {0u, 6u})
+        {
+            SearchResult pruned = searchPaths(fixture.artifact, fixture.query, 0, maxDepth, 1, true);
+            SearchResult full = searchPaths(fixture.artifact, fixture.query, 0, maxDepth, 1, false);
+            check(pruned.paths == full.paths, fixture.name + ", maxDepth " + std::to_string(maxDepth) + ": pruning");
+        }
+}
+
+/// countPaths against the enumerated paths on acyclic ICFGs, whose calls nest at most three deep, and the summary
+/// it writes: the count, and the nodes on any path as runs of consecutive ids
+void checkPathCount(const std::vector<Fixture> &programs)
+{
+    for (const Fixture &fixture : programs)
+    {
+        std::set<unsigned> nodes;
+        for (auto &path : fixture.paths)
+            nodes.insert(path.begin(), path.end());
+        std::string runs;
+        for (auto it = nodes.begin(); it != nodes.end();)
+        {
+            unsigned first = *it, last = first;
+            while (++it != nodes.end() && *it == last + 1)
+                ++last;
+            runs += (runs.empty() ? "" : ", ") + std::to_string(first) + (last > first ? "-" + std::to_string(last) : "");
+        }
+        std::string expected = "paths: " + std::to_string(fixture.paths.size()) + "\nnodes: " +
+                               std::to_string(nodes.size()) + "\n" + runs + "\n";
+
+        for (unsigned k : {3u, 5u})
+        {
+            CFGAnalysis analyzer(fixture.artifact);
+            analyzer.setQuery(fixture.query);
+            analyzer.countPaths(k);
+            analyzer.dumpSummary();
+            check(readFile("cfga-test.sum.txt", false) == expected, fixture.name + ", k " + std::to_string(k) +
+                                                                    ": path count and coverage");
+            std::remove("cfga-test.sum.txt");
+        }
+    }
+}
+
+}
+
+int main()
+{
+    checkPathTrie();
+    checkPathLimit();
+    checkQueryParsing();
+    checkArtifactIds();
+    checkPathWriter();
+    std::vector<Fixture> programs = fixtures(false);
+    checkCallPaths(programs);
+    checkPruning(programs);
+    checkThreadLimits(programs);
+    checkPathCount(fixtures(true));
+
+    if (failures)
+        std::cout << failures << " checks failed\n";
+    return failures ? 1 : 0;
+}
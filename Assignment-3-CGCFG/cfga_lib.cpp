@@ -1,32 +1,291 @@
 /**
  * cfga_lib.cpp
- * @author kisslune 
+ * @author kisslune
  */
 
 #include "CFGA.h"
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#ifdef CFGA_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 using namespace SVF;
 using namespace llvm;
 using namespace std;
 
 
-CFGAnalysis::CFGAnalysis(SVF::ICFG *icfg)
+PathTrie::PathTrie()
 {
-    for (auto &it : *icfg)
+    nodes.push_back({0, 0, false});
+}
+
+
+void PathTrie::clear()
+{
+    nodes.assign(1, {0, 0, false});
+    children.clear();
+    numPaths = 0;
+}
+
+
+bool PathTrie::insert(const std::vector<unsigned> &path)
+{
+    unsigned cur = 0;
+    for (auto label : path)
+    {
+        auto it = children.emplace((uint64_t) cur << 32 | label, (unsigned) nodes.size());
+        if (it.second)
+            nodes.push_back({label, cur, false});
+        cur = it.first->second;
+    }
+    if (nodes[cur].terminal)
+        return false;
+    nodes[cur].terminal = true;
+    numPaths++;
+    return true;
+}
+
+
+bool PathTrie::contains(const std::vector<unsigned> &path) const
+{
+    unsigned cur = 0;
+    for (auto label : path)
     {
-        auto node = it.second;
-        if (auto fEntry = dyn_cast<FunEntryICFGNode>(node))
+        auto it = children.find((uint64_t) cur << 32 | label);
+        if (it == children.end())
+            return false;
+        cur = it->second;
+    }
+    return nodes[cur].terminal;
+}
+
+
+void PathTrie::forEachPath(const std::function<void(const std::vector<unsigned> &)> &visit) const
+{
+    // Children lists sorted by label; a prefix comes before its extensions when visited in preorder
+    std::vector<unsigned> offsets(nodes.size() + 1, 0);
+    for (unsigned n = 1; n < nodes.size(); n++)
+        offsets[nodes[n].parent + 1]++;
+    for (unsigned n = 0; n < nodes.size(); n++)
+        offsets[n + 1] += offsets[n];
+    std::vector<unsigned> kids(nodes.size() - 1);
+    std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned n = 1; n < nodes.size(); n++)
+        kids[fill[nodes[n].parent]++] = n;
+    for (unsigned n = 0; n < nodes.size(); n++)
+        std::sort(kids.begin() + offsets[n], kids.begin() + offsets[n + 1],
+                  [this](unsigned a, unsigned b) { return nodes[a].label < nodes[b].label; });
+
+    std::vector<unsigned> path;
+    std::vector<std::pair<unsigned, unsigned>> stack{{0, offsets[0]}};   // (node, next child)
+    while (!stack.empty())
+    {
+        auto &top = stack.back();
+        if (top.second == offsets[top.first + 1])
         {
-            if (fEntry->getFun()->getName() == "main")
-                sources.insert(it.first);
+            stack.pop_back();
+            if (!path.empty())
+                path.pop_back();
+            continue;
         }
-        if (auto fExit = dyn_cast<FunExitICFGNode>(node))
+        unsigned child = kids[top.second++];
+        path.push_back(nodes[child].label);
+        if (nodes[child].terminal)
+            visit(path);
+        stack.push_back({child, offsets[child]});
+    }
+}
+
+
+FlatICFG::FlatICFG(SVF::ICFG *icfg)
+{
+    SVFIRArtifact artifact;
+    artifact.addICFG(icfg);
+    build(artifact);
+}
+
+
+FlatICFG::FlatICFG(const SVFIRArtifact &artifact)
+{
+    build(artifact);
+}
+
+
+void FlatICFG::build(const SVFIRArtifact &artifact)
+{
+    unsigned bound = 0;
+    for (auto &node : artifact.nodes)
+        bound = std::max(bound, node.id + 1);
+    kinds.assign(bound, NoNode);
+    funs.assign(bound, 0);
+    funNames = artifact.funs;
+    if (funNames.empty())
+        funNames.push_back("");
+    callNodes.assign(bound, 0);
+    for (auto &node : artifact.nodes)
+    {
+        nodeIds.push_back(node.id);
+        kinds[node.id] = node.kind;
+        funs[node.id] = node.fun;
+        callNodes[node.id] = node.callNode;
+    }
+    std::sort(nodeIds.begin(), nodeIds.end());
+
+    // Compressed adjacency; a stable counting sort keeps each node's out-edges in ICFG order.  Edges between
+    // missing nodes, which SVFIRArtifact::load rejects, are dropped from artifacts built in memory
+    auto isEdge = [this](const SVFIRArtifact::Edge &edge) { return hasNode(edge.src) && hasNode(edge.dst); };
+    outOffsets.assign(bound + 1, 0);
+    inOffsets.assign(bound + 1, 0);
+    for (auto &edge : artifact.edges)
+    {
+        if (!isEdge(edge))
+            continue;
+        outOffsets[edge.src + 1]++;
+        inOffsets[edge.dst + 1]++;
+    }
+    for (unsigned n = 0; n < bound; n++)
+    {
+        outOffsets[n + 1] += outOffsets[n];
+        inOffsets[n + 1] += inOffsets[n];
+    }
+    outEdges.resize(outOffsets[bound]);
+    inEdges.resize(inOffsets[bound]);
+    std::vector<unsigned> outFill(outOffsets.begin(), outOffsets.end() - 1);
+    std::vector<unsigned> inFill(inOffsets.begin(), inOffsets.end() - 1);
+    for (auto &edge : artifact.edges)
+    {
+        if (!isEdge(edge))
+            continue;
+        unsigned callSite = edge.kind == SVFIRArtifact::CallCF ? edge.src :
+                            edge.kind == SVFIRArtifact::RetCF ? callNodes[edge.dst] : 0;
+        outEdges[outFill[edge.src]++] = {edge.dst, callSite, edge.kind};
+        inEdges[inFill[edge.dst]++] = {edge.src, callSite, edge.kind};
+    }
+}
+
+
+CFGAnalysis::CFGAnalysis(SVF::ICFG *icfg) : graph(icfg), moduleName(PAG::getPAG()->getModuleIdentifier())
+{
+    selectMain();
+}
+
+
+CFGAnalysis::CFGAnalysis(const SVFIRArtifact &artifact) : graph(artifact), moduleName(artifact.module)
+{
+    selectMain();
+}
+
+
+void CFGAnalysis::selectMain()
+{
+    for (auto id : graph.getNodes())
+    {
+        if (graph.getKind(id) == SVFIRArtifact::FunEntry && graph.getFunName(id) == "main")
+            sources.insert(id);
+        if (graph.getKind(id) == SVFIRArtifact::FunExit && graph.getFunName(id) == "main")
+            sinks.insert(id);
+    }
+}
+
+
+void CFGAnalysis::setQuery(const CFGQuery &query)
+{
+    sources = query.sources;
+    sinks = query.sinks;
+    reachablePaths.clear();
+    numPaths = 0;
+    truncated = false;
+}
+
+
+bool CFGAnalysis::resolveNodes(const std::string &spec, bool source, std::set<unsigned> &nodes) const
+{
+    if (!spec.empty() && std::all_of(spec.begin(), spec.end(), [](unsigned char c) { return std::isdigit(c); }))
+    {
+        unsigned id;
+        std::from_chars_result parsed = std::from_chars(spec.data(), spec.data() + spec.size(), id);
+        if (parsed.ec != std::errc() || !graph.hasNode(id))
         {
-            if (fExit->getFun()->getName() == "main")
-                sinks.insert(it.first);
+            std::cout << "no ICFG node " + spec + "!!\n";
+            return false;
         }
+        nodes.insert(id);
+        return true;
+    }
+
+    std::string kind = source ? "entry" : "exit";
+    std::string fun = spec;
+    size_t colon = spec.find(':');
+    if (colon != std::string::npos)
+    {
+        kind = spec.substr(0, colon);
+        fun = spec.substr(colon + 1);
     }
+    if (kind == "node")
+        return resolveNodes(fun, source, nodes);
+    if (kind != "entry" && kind != "exit" && kind != "call" && kind != "ret")
+    {
+        std::cout << "unknown node kind " + kind + "!!\n";
+        return false;
+    }
+
+    // Call sites are matched through their call edges, so indirect calls resolved by SVF count too
+    auto calls = [this, &fun](unsigned callNode) {
+        return std::any_of(graph.outBegin(callNode), graph.outEnd(callNode), [this, &fun](const FlatICFG::Edge &edge) {
+            return edge.kind == SVFIRArtifact::CallCF && graph.getFunName(edge.node) == fun;
+        });
+    };
+    size_t before = nodes.size();
+    for (auto id : graph.getNodes())
+    {
+        auto nodeKind = graph.getKind(id);
+        if ((kind == "entry" && nodeKind == SVFIRArtifact::FunEntry && graph.getFunName(id) == fun) ||
+            (kind == "exit" && nodeKind == SVFIRArtifact::FunExit && graph.getFunName(id) == fun) ||
+            (kind == "call" && nodeKind == SVFIRArtifact::FunCall && calls(id)) ||
+            (kind == "ret" && nodeKind == SVFIRArtifact::FunRet && calls(graph.getCallNode(id))))
+            nodes.insert(id);
+    }
+    if (nodes.size() == before)
+    {
+        std::cout << "no ICFG node matches " + spec + "!!\n";
+        return false;
+    }
+    return true;
+}
+
+
+bool CFGAnalysis::parseQueries(const std::string &text, std::vector<CFGQuery> &queries) const
+{
+    std::istringstream queryList(text);
+    for (std::string line; std::getline(queryList, line, ';');)
+    {
+        line.erase(std::remove_if(line.begin(), line.end(), [](unsigned char c) { return std::isspace(c); }),
+                   line.end());
+        if (line.empty())
+            continue;
+        size_t arrow = line.find("->");
+        if (arrow == std::string::npos)
+        {
+            std::cout << "query " + line + " is not sources->sinks!!\n";
+            return false;
+        }
+        CFGQuery query;
+        std::istringstream srcSpecs(line.substr(0, arrow)), snkSpecs(line.substr(arrow + 2));
+        for (std::string spec; std::getline(srcSpecs, spec, ',');)
+            if (!resolveNodes(spec, true, query.sources))
+                return false;
+        for (std::string spec; std::getline(snkSpecs, spec, ',');)
+            if (!resolveNodes(spec, false, query.sinks))
+                return false;
+        queries.push_back(query);
+    }
+    return true;
 }
 
 
@@ -34,26 +293,666 @@ void CFGAnalysis::recordPath(const std::vector<unsigned int>& path)
 {
     if (path.empty())
         return;
-    reachablePaths.insert(path);
+    if (limitReached())
+    {
+        // Exactly maxPaths paths are complete; only one more shows that the limit cut the search short
+        if (pathCallback || !reachablePaths.contains(path))
+            truncated = true;
+        return;
+    }
+    if (pathCallback)
+        pathCallback(path);
+    else if (!reachablePaths.insert(path))
+        return;
+    ++numPaths;
+}
+
+
+void CFGAnalysis::analyze()
+{
+    // Sources and sinks are specified when an analyzer is instantiated, or by setQuery.
+    // The search starts as one open prefix per source. With several threads the prefixes are first
+    // split into enough subtrees to share out; the split keeps DFS order, so merging the subtrees'
+    // paths back in item order gives exactly the paths, and the order, of the serial search.
+    auto pathOf = [](const std::vector<Step> &prefix) {
+        std::vector<unsigned> path;
+        for (auto &step : prefix)
+            path.push_back(step.node);
+        return path;
+    };
+
+    if (pruning)
+        sinkIndex.build(graph, sinks);
+
+    std::vector<SearchItem> items;
+    std::vector<signed char> memo;
+    for (auto src : sources)
+    {
+        if (sinks.count(src))
+            items.push_back({{{src, 0}}, false});
+        if (graph.outBegin(src) == graph.outEnd(src) || !isLive(src, 0, callStack, memo))
+            continue;
+        if (maxDepth == 1)
+            truncated = true;
+        else
+            items.push_back({{{src, 0}}, true});
+    }
+
+    unsigned threads = numThreads != 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+    auto countOpen = [&items]() {
+        return std::count_if(items.begin(), items.end(), [](const SearchItem &item) { return item.open; });
+    };
+    size_t open = countOpen();
+    for (unsigned round = 0; threads > 1 && round < 32 && open > 0 && open < threads * 8; round++)
+    {
+        std::vector<SearchItem> split;
+        for (auto &item : items)
+        {
+            if (item.open)
+                expand(item, callStack, split, truncated);
+            else
+                split.push_back(std::move(item));
+        }
+        items.swap(split);
+        open = countOpen();
+    }
+
+    // The searches look for one path beyond maxPaths, which tells a truncated result from one with exactly
+    // maxPaths paths
+    if (threads <= 1 || open <= 1)
+    {
+        PathCallback record = [this](const std::vector<unsigned> &path) { recordPath(path); };
+        for (auto &item : items)
+        {
+            if (limitReached() && truncated)
+                break;
+            if (!item.open)
+                recordPath(pathOf(item.prefix));
+            else
+                search(item.prefix, callStack, record, maxPaths == 0 ? 0 : maxPaths - numPaths + 1, truncated);
+        }
+        return;
+    }
+
+    // Thread-local buffers, one per item: each path is its length followed by its nodes.
+    // No subtree can contribute more than maxPaths paths, and the one beyond, to the merged result.
+    std::vector<std::vector<unsigned>> buffers(items.size());
+    std::vector<char> cuts(items.size(), 0);
+    std::atomic<size_t> nextItem(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < std::min<size_t>(threads, open); t++)
+        workers.emplace_back([&]() {
+            CallContexts contexts = callStack;
+            for (size_t i; (i = nextItem.fetch_add(1)) < items.size();)
+            {
+                if (!items[i].open)
+                    continue;
+                auto &buffer = buffers[i];
+                PathCallback record = [&buffer](const std::vector<unsigned> &path) {
+                    buffer.push_back(path.size());
+                    buffer.insert(buffer.end(), path.begin(), path.end());
+                };
+                bool cut = false;
+                search(items[i].prefix, contexts, record, maxPaths == 0 ? 0 : maxPaths + 1, cut);
+                cuts[i] = cut;
+            }
+        });
+    for (auto &worker : workers)
+        worker.join();
+
+    std::vector<unsigned> path;
+    for (size_t i = 0; i < items.size() && !(limitReached() && truncated); i++)
+    {
+        if (!items[i].open)
+        {
+            recordPath(pathOf(items[i].prefix));
+            continue;
+        }
+        auto &buffer = buffers[i];
+        for (size_t pos = 0; pos < buffer.size() && !(limitReached() && truncated); pos += buffer[pos] + 1)
+        {
+            path.assign(buffer.begin() + pos + 1, buffer.begin() + pos + 1 + buffer[pos]);
+            recordPath(path);
+        }
+        truncated |= cuts[i] != 0;
+        std::vector<unsigned>().swap(buffer);
+    }
+}
+
+
+void CFGAnalysis::analyze(SVF::ICFG *)
+{
+    analyze();
+}
+
+
+void CFGAnalysis::expand(const SearchItem &item, CallContexts &contexts, std::vector<SearchItem> &out, bool &cut) const
+{
+    const Step &last = item.prefix.back();
+    std::vector<signed char> memo;
+    for (auto edge = graph.outBegin(last.node); edge != graph.outEnd(last.node); ++edge)
+    {
+        unsigned ctx;
+        if (!contexts.successor(*edge, last.ctx, ctx))
+            continue;
+        unsigned dst = edge->node;
+        if (std::any_of(item.prefix.begin(), item.prefix.end(),
+                        [dst, ctx](const Step &step) { return step.node == dst && step.ctx == ctx; }) ||
+            !isLive(dst, ctx, contexts, memo))
+            continue;
+
+        SearchItem next{item.prefix, false};
+        next.prefix.push_back({dst, ctx});
+        if (sinks.count(dst))
+            out.push_back(next);
+        if (graph.outBegin(dst) == graph.outEnd(dst))
+            continue;
+        if (maxDepth != 0 && next.prefix.size() >= maxDepth)
+        {
+            cut = true;
+            continue;
+        }
+        next.open = true;
+        out.push_back(std::move(next));
+    }
 }
 
 
-void CFGAnalysis::dumpPaths()
+size_t CFGAnalysis::search(const std::vector<Step> &prefix, CallContexts &contexts, const PathCallback &record,
+                           size_t budget, bool &cut) const
 {
-    std::string fname = PAG::getPAG()->getModuleIdentifier() + ".res.txt";
-    std::ofstream outFile(fname, std::ios::out);
+    // An explicit stack, so deep ICFGs cannot overflow the native one. A node may be revisited
+    // on a path only under another call stack.
+    struct Frame
+    {
+        unsigned node;
+        const FlatICFG::Edge *next;
+        unsigned ctx;
+    };
+
+    std::vector<Frame> frames;
+    std::vector<unsigned> path;
+    std::unordered_set<uint64_t> onPath;
+    std::vector<signed char> memo;
+    size_t found = 0;
+
+    // The prefix itself has been recorded already
+    for (auto &step : prefix)
+    {
+        path.push_back(step.node);
+        onPath.insert(pathKey(step.node, step.ctx));
+    }
+    frames.push_back({prefix.back().node, graph.outBegin(prefix.back().node), prefix.back().ctx});
+
+    while (!frames.empty())
+    {
+        Frame &top = frames.back();
+        if (top.next == graph.outEnd(top.node) || (budget != 0 && found >= budget))
+        {
+            onPath.erase(pathKey(top.node, top.ctx));
+            path.pop_back();
+            frames.pop_back();
+            continue;
+        }
+        const FlatICFG::Edge &edge = *top.next++;
+        unsigned ctx;
+        if (!contexts.successor(edge, top.ctx, ctx) || onPath.count(pathKey(edge.node, ctx)) ||
+            !isLive(edge.node, ctx, contexts, memo))
+            continue;
+
+        unsigned dst = edge.node;
+        path.push_back(dst);
+        onPath.insert(pathKey(dst, ctx));
+        if (sinks.count(dst) && (budget == 0 || found < budget))
+        {
+            record(path);
+            found++;
+        }
+        frames.push_back({dst, graph.outBegin(dst), ctx});
+        if (maxDepth != 0 && path.size() >= maxDepth && graph.outBegin(dst) != graph.outEnd(dst))
+        {
+            frames.back().next = graph.outEnd(dst);
+            cut = true;
+        }
+    }
+    return found;
+}
+
+
+CallContexts::CallContexts()
+{
+    callStack.push_back({0, 0});
+}
+
+
+unsigned CallContexts::push(unsigned ctx, unsigned callSite)
+{
+    auto it = contextIds.emplace((uint64_t) ctx << 32 | callSite, (unsigned) callStack.size());
+    if (it.second)
+        callStack.push_back({ctx, callSite});
+    return it.first->second;
+}
+
+
+bool CallContexts::successor(const FlatICFG::Edge &edge, unsigned ctx, unsigned &succ)
+{
+    if (edge.kind == SVFIRArtifact::CallCF)
+    {
+        // A call site already on the stack is recursion; entering it again would never end
+        for (unsigned c = ctx; c != 0; c = callStack[c].parent)
+            if (callStack[c].callSite == edge.callSite)
+                return false;
+        succ = push(ctx, edge.callSite);
+        return true;
+    }
+    if (edge.kind == SVFIRArtifact::RetCF)
+    {
+        // With an empty stack the path leaves the function it started in, and any caller is fine
+        if (ctx == 0)
+        {
+            succ = 0;
+            return true;
+        }
+        if (callStack[ctx].callSite != edge.callSite)
+            return false;
+        succ = callStack[ctx].parent;
+        return true;
+    }
+    succ = ctx;
+    return true;
+}
+
+
+void SinkIndex::build(const FlatICFG &graph, const std::set<unsigned> &sinks)
+{
+    unsigned numNodes = graph.getIdBound();
+    reachesExit.assign(numNodes, false);
+    reachesBelow.assign(numNodes, false);
+    reachesAny.assign(numNodes, false);
+    retOfCall.clear();
+    std::vector<unsigned> exits;
+    for (auto id : graph.getNodes())
+    {
+        if (graph.getKind(id) == SVFIRArtifact::FunExit)
+            exits.push_back(id);
+        for (auto edge = graph.outBegin(id); edge != graph.outEnd(id); ++edge)
+            if (edge->kind == SVFIRArtifact::RetCF)
+                retOfCall[edge->callSite] = edge->node;
+    }
+
+    // Backwards from the seeds. A call node is passed over when its return site is reached and
+    // its callee reaches its exit; descend also enters callees, escape also leaves through unmatched returns.
+    auto propagate = [&](std::vector<bool> &reach, std::vector<unsigned> worklist, bool descend, bool escape) {
+        auto mark = [&](unsigned n) {
+            if (!reach[n])
+            {
+                reach[n] = true;
+                worklist.push_back(n);
+            }
+        };
+        for (auto n : worklist)
+            reach[n] = true;
+        while (!worklist.empty())
+        {
+            unsigned n = worklist.back();
+            worklist.pop_back();
+            for (auto edge = graph.inBegin(n); edge != graph.inEnd(n); ++edge)
+            {
+                if (edge->kind == SVFIRArtifact::IntraCF || (descend && edge->kind == SVFIRArtifact::CallCF) ||
+                    (escape && edge->kind == SVFIRArtifact::RetCF))
+                    mark(edge->node);
+                else if (edge->kind == SVFIRArtifact::CallCF && reachesExit[n])
+                {
+                    auto ret = retOfCall.find(edge->node);
+                    if (ret != retOfCall.end() && reach[ret->second])
+                        mark(edge->node);
+                }
+            }
+            if (graph.getKind(n) == SVFIRArtifact::FunRet)
+            {
+                unsigned call = graph.getCallNode(n);
+                for (auto edge = graph.outBegin(call); edge != graph.outEnd(call); ++edge)
+                    if (edge->kind == SVFIRArtifact::CallCF && reachesExit[edge->node])
+                        mark(call);
+            }
+        }
+    };
+
+    propagate(reachesExit, exits, false, false);
+    propagate(reachesBelow, std::vector<unsigned>(sinks.begin(), sinks.end()), true, false);
+    std::vector<unsigned> below;
+    for (unsigned n = 0; n < numNodes; n++)
+        if (reachesBelow[n])
+            below.push_back(n);
+    propagate(reachesAny, below, true, true);
+}
+
+
+bool SinkIndex::canReach(unsigned node, unsigned ctx, const CallContexts &contexts, std::vector<signed char> &memo) const
+{
+    if (node >= reachesAny.size() || !reachesAny[node])
+        return false;
+    if (reachesBelow[node] || ctx == 0)
+        return true;
+    if (!reachesExit[node])
+        return false;
+    // Otherwise the path has to return to the innermost call site
+    if (memo.size() <= ctx)
+        memo.resize(ctx + 1, -1);
+    if (memo[ctx] < 0)
+    {
+        auto ret = retOfCall.find(contexts.callSiteOf(ctx));
+        bool live = ret != retOfCall.end() && canReach(ret->second, contexts.parentOf(ctx), contexts, memo);
+        memo[ctx] = live;
+    }
+    return memo[ctx] != 0;
+}
+
+
+void CFGAnalysis::countPaths(unsigned k)
+{
+    // Bounded call strings, interned; the empty string lets a return go to any caller
+    std::vector<std::vector<unsigned>> strings{{}};
+    std::map<std::vector<unsigned>, unsigned> stringIds{{{}, 0}};
+    auto successor = [&](const FlatICFG::Edge &edge, unsigned ctx, unsigned &succ) {
+        std::vector<unsigned> str = strings[ctx];
+        if (edge.kind == SVFIRArtifact::CallCF)
+        {
+            if (std::find(str.begin(), str.end(), edge.callSite) != str.end())
+                return false;
+            if (k == 0)
+            {
+                succ = 0;
+                return true;
+            }
+            str.push_back(edge.callSite);
+            if (str.size() > k)
+                str.erase(str.begin());
+        }
+        else if (edge.kind == SVFIRArtifact::RetCF)
+        {
+            if (str.empty())
+            {
+                succ = 0;
+                return true;
+            }
+            if (str.back() != edge.callSite)
+                return false;
+            str.pop_back();
+        }
+        else
+        {
+            succ = ctx;
+            return true;
+        }
+        auto it = stringIds.emplace(str, (unsigned) strings.size());
+        if (it.second)
+            strings.push_back(str);
+        succ = it.first->second;
+        return true;
+    };
+
+    auto add = [this](uint64_t &sum, uint64_t n) {
+        if (n > UINT64_MAX - sum)
+        {
+            sum = UINT64_MAX;
+            countSaturated = true;
+        }
+        else
+            sum += n;
+    };
+
+    // Post-order DFS over the states; count[s] = [s is a sink] + the counts of its successors
+    struct State
+    {
+        uint64_t count;
+        bool done;
+    };
+    struct Frame
+    {
+        unsigned node;
+        const FlatICFG::Edge *next;
+        unsigned ctx;
+        uint64_t count;
+    };
+    std::unordered_map<uint64_t, State> states;
+    std::vector<Frame> frames;
+    pathCount = 0;
+    countSaturated = false;
+
+    auto enter = [&](unsigned node, unsigned ctx) {
+        states[pathKey(node, ctx)] = {0, false};
+        frames.push_back({node, graph.outBegin(node), ctx, sinks.count(node) ? 1u : 0u});
+    };
+    for (auto src : sources)
+    {
+        auto it = states.find(pathKey(src, 0));
+        if (it != states.end())
+        {
+            add(pathCount, it->second.count);
+            continue;
+        }
+        enter(src, 0);
+        while (!frames.empty())
+        {
+            Frame &top = frames.back();
+            if (top.next == graph.outEnd(top.node))
+            {
+                uint64_t count = top.count;
+                states[pathKey(top.node, top.ctx)] = {count, true};
+                frames.pop_back();
+                add(frames.empty() ? pathCount : frames.back().count, count);
+                continue;
+            }
+            const FlatICFG::Edge &edge = *top.next++;
+            unsigned ctx;
+            if (!successor(edge, top.ctx, ctx))
+                continue;
+            auto succ = states.find(pathKey(edge.node, ctx));
+            if (succ == states.end())
+                enter(edge.node, ctx);
+            else if (succ->second.done)
+                add(top.count, succ->second.count);
+        }
+    }
+
+    std::set<unsigned> covered;
+    for (auto &it : states)
+        if (it.second.count != 0)
+            covered.insert(it.first >> 32);
+    coverage.assign(covered.begin(), covered.end());
+}
+
+
+bool CFGAnalysis::dumpSummary(const std::string &suffix)
+{
+    std::ofstream outFile;
+    if (!openResult(outFile, suffix, ".sum.txt"))
+        return false;
+
+    outFile << "paths: " << (countSaturated ? ">= " : "") << pathCount << "\n";
+    outFile << "nodes: " << coverage.size() << "\n";
+    // Runs of consecutive ids are written as first-last
+    for (size_t i = 0; i < coverage.size();)
+    {
+        size_t j = i;
+        while (j + 1 < coverage.size() && coverage[j + 1] == coverage[j] + 1)
+            j++;
+        outFile << (i == 0 ? "" : ", ") << coverage[i];
+        if (j > i)
+            outFile << "-" << coverage[j];
+        i = j + 1;
+    }
+    outFile << "\n";
+
+    outFile.close();
+    if (!outFile)
+    {
+        std::cout << "error writing " + moduleName + suffix + ".sum.txt!!\n";
+        return false;
+    }
+    return true;
+}
+
+
+bool CFGAnalysis::openResult(std::ofstream &outFile, const std::string &suffix, const std::string &ext) const
+{
+    std::string fname = moduleName + suffix + ext;
+    outFile.open(fname, std::ios::out);
     if (!outFile)
     {
         std::cout << "error opening " + fname + "!!\n";
-        return;
+        return false;
+    }
+    return true;
+}
+
+
+bool CFGAnalysis::openWriter(PathWriter &writer, const std::string &suffix) const
+{
+    std::string fname = moduleName + suffix +
+                        (outputFormat == PathFormat::Delta ? ".res.bin" : ".res.txt") + (compressOutput ? ".gz" : "");
+    return writer.open(fname);
+}
+
+
+bool CFGAnalysis::dumpPaths(const std::string &suffix)
+{
+    PathWriter writer(outputFormat, compressOutput);
+    if (!openWriter(writer, suffix))
+        return false;
+
+    reachablePaths.forEachPath([&writer](const std::vector<unsigned> &path) { writer.write(path); });
+
+    return writer.close();
+}
+
+
+PathWriter::PathWriter(PathFormat format, bool compress) : format(format), compress(compress)
+{
+    buffer.resize(1 << 20);
+}
+
+
+PathWriter::~PathWriter()
+{
+    close();
+}
+
+
+bool PathWriter::open(const std::string &fname)
+{
+    if (compress)
+    {
+#ifdef CFGA_HAVE_ZLIB
+        gz = gzopen(fname.c_str(), "wb");
+#else
+        std::cout << "compressed output needs zlib, which this build does not have!!\n";
+        return false;
+#endif
     }
+    else
+        file = std::fopen(fname.c_str(), "wb");
+    if (!file && !gz)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return false;
+    }
+    fileName = fname;
+    failed = false;
+    used = 0;
+    previous.clear();
+    if (format == PathFormat::Delta)
+        put("CFGP\1", 5);
+    return true;
+}
+
+
+void PathWriter::put(const char *data, size_t len)
+{
+    if (used + len > buffer.size())
+        flush();
+    std::memcpy(buffer.data() + used, data, len);
+    used += len;
+}
+
+
+void PathWriter::putVarint(uint64_t value)
+{
+    char bytes[10];
+    size_t len = 0;
+    do
+    {
+        bytes[len++] = (char) ((value & 0x7f) | (value >= 0x80 ? 0x80 : 0));
+        value >>= 7;
+    } while (value != 0);
+    put(bytes, len);
+}
+
 
-    for (auto &path : reachablePaths)
+void PathWriter::write(const std::vector<unsigned> &path)
+{
+    if (format == PathFormat::Text)
     {
+        // Same bytes as 'os << node << ", "' per node and std::endl per path
+        char digits[16];
         for (auto node : path)
-            outFile << node << ", ";
-        outFile << endl;
+        {
+            char *end = std::to_chars(digits, digits + sizeof(digits) - 2, node).ptr;
+            *end++ = ',';
+            *end++ = ' ';
+            put(digits, end - digits);
+        }
+        put("\n", 1);
+        return;
     }
 
-    outFile.close();
-}
\ No newline at end of file
+    size_t shared = 0;
+    while (shared < path.size() && shared < previous.size() && path[shared] == previous[shared])
+        shared++;
+    putVarint(shared);
+    putVarint(path.size() - shared);
+    int64_t last = shared == 0 ? 0 : path[shared - 1];
+    for (size_t i = shared; i < path.size(); i++)
+    {
+        // Zigzag on the two's complement bits, as shifting a negative value left is undefined
+        uint64_t delta = (uint64_t) ((int64_t) path[i] - last);
+        putVarint((delta << 1) ^ (0 - (delta >> 63)));
+        last = path[i];
+    }
+    previous = path;
+}
+
+
+void PathWriter::flush()
+{
+    if (used == 0)
+        return;
+#ifdef CFGA_HAVE_ZLIB
+    if (gz && gzwrite((::gzFile) gz, buffer.data(), (unsigned) used) != (int) used)
+        failed = true;
+#endif
+    if (file && std::fwrite(buffer.data(), 1, used, file) != used)
+        failed = true;
+    used = 0;
+}
+
+
+bool PathWriter::close()
+{
+    if (!file && !gz)
+        return true;
+    flush();
+    bool ok = !failed;
+#ifdef CFGA_HAVE_ZLIB
+    if (gz)
+        ok = gzclose((::gzFile) gz) == Z_OK && ok;
+#endif
+    if (file)
+        ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    gz = nullptr;
+    if (!ok)
+        std::cout << "error writing " + fileName + "!!\n";
+    return ok;
+}
@@ -0,0 +1,74 @@
+/**
+ * A4Batch.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+unsigned CFLRBatch::run(const Runner &runner)
+{
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const Job &a, const Job &b) { return a.memory > b.memory; });
+
+    unsigned numThreads = jobs ? jobs : std::thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+    numThreads = std::min<size_t>(numThreads, pending.size());
+
+    std::mutex mutex;
+    std::condition_variable released;
+    std::vector<bool> started(pending.size(), false);
+    size_t numStarted = 0;
+    unsigned running = 0;
+    uint64_t inFlight = 0;      // estimated memory of the running jobs
+    unsigned failed = 0;
+
+    // The largest job not yet started that fits next to the running ones, or pending.size() if none does
+    auto pick = [&]() {
+        for (size_t i = 0; i < pending.size(); ++i)
+            if (!started[i] &&
+                (running == 0 || memoryBudget == 0 || inFlight + pending[i].memory <= memoryBudget))
+                return i;
+        return pending.size();
+    };
+
+    auto work = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (numStarted < pending.size())
+        {
+            size_t next = pick();
+            if (next == pending.size())
+            {
+                released.wait(lock);
+                continue;
+            }
+            started[next] = true;
+            ++numStarted;
+            ++running;
+            inFlight += pending[next].memory;
+
+            lock.unlock();
+            bool ok = runner(pending[next].input);
+            lock.lock();
+
+            --running;
+            inFlight -= pending[next].memory;
+            if (!ok)
+                ++failed;
+            released.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t)
+        threads.emplace_back(work);
+    for (auto &thread : threads)
+        thread.join();
+
+    pending.clear();
+    return failed;
+}
@@ -0,0 +1,100 @@
+/**
+ * A4Fields.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <set>
+
+EdgeLabel CFLRGraph::internLabel(EdgeLabel base, unsigned field)
+{
+    assert(base < NumEdgeLabels && "only labels of EdgeLabelType can be parameterized");
+    if (field == 0)
+        return base;
+    EdgeLabel even = base & ~1u;
+    auto found = fieldLabelIds.find(packLabel(even, field));
+    if (found != fieldLabelIds.end())
+        return found->second | (base & 1);
+
+    assert(getLabelNum() + 2 <= MaxEdgeLabels && "too many field-indexed labels");
+    EdgeLabel label = getLabelNum();
+    fieldLabels.push_back(packLabel(even, field));
+    fieldLabels.push_back(packLabel(even | 1, field));
+    fieldLabelIds.emplace(packLabel(even, field), label);
+    return label | (base & 1);
+}
+
+
+EdgeLabel CFLRGraph::findLabel(EdgeLabel base, unsigned field) const
+{
+    if (field == 0)
+        return base;
+    auto found = fieldLabelIds.find(packLabel(base & ~1u, field));
+    return found == fieldLabelIds.end() ? CFLRGrammar::NoLabel : found->second | (base & 1);
+}
+
+
+EdgeLabel CFLRGraph::gepLabel(int64_t field, unsigned fieldLimit)
+{
+    if (field <= 0)
+        return Copy;
+    return internLabel(Gep, std::min<int64_t>(field, fieldLimit));
+}
+
+
+std::string CFLRGraph::labelName(EdgeLabel label) const
+{
+    std::string name = CFLRGrammar::labelName(baseOf(label));
+    if (fieldOf(label))
+        name += "_" + std::to_string(fieldOf(label));
+    return name;
+}
+
+
+void CFLR::addFieldProductions()
+{
+    // A grammar set by setGrammar is solved as given
+    if (fieldProductions || customGrammar)
+        return;
+    fieldProductions = true;
+
+    std::set<unsigned> gepFields;
+    for (EdgeLabel label = NumEdgeLabels; label < graph->getLabelNum(); ++label)
+        if (graph->baseOf(label) == Gep)
+            gepFields.insert(graph->fieldOf(label));
+    if (gepFields.empty())
+        return;
+
+    // The fields a pointer can reach from the start of an object, adding up the offsets of its Geps
+    unsigned limit = options.fieldLimit;
+    std::set<unsigned> fields = {0};
+    std::vector<unsigned> pending = {0};
+    while (!pending.empty())
+    {
+        unsigned field = pending.back();
+        pending.pop_back();
+        for (unsigned offset : gepFields)
+        {
+            unsigned next = std::min(field + offset, limit);
+            if (fields.insert(next).second)
+                pending.push_back(next);
+        }
+    }
+
+    for (unsigned k : fields)
+    {
+        EdgeLabel pt = graph->internLabel(PT, k);
+        for (unsigned j : gepFields)
+            grammar.addBinary(graph->internLabel(PT, std::min(k + j, limit)), graph->findLabel(GepBar, j), pt);
+        if (k == 0)
+            continue;
+        EdgeLabel pv = graph->internLabel(PV, k);
+        EdgeLabel vp = graph->internLabel(VP, k);
+        grammar.addBinary(pt, CopyBar, pt);
+        grammar.addBinary(pv, Store, pt);
+        grammar.addBinary(vp, pt ^ 1, Load);
+        grammar.addBinary(Copy, pv, vp);
+        grammar.addInverse(pt, pt ^ 1);
+    }
+}
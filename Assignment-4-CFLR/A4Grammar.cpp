@@ -0,0 +1,121 @@
+/**
+ * A4Grammar.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <sstream>
+
+static const char *const labelNames[NumEdgeLabels] = {
+        "Addr", "AddrBar",
+        "Copy", "CopyBar",
+        "Store", "StoreBar",
+        "Load", "LoadBar",
+        "PT", "PTBar",
+        "SV", "SVBar",
+        "PV", "PVBar",
+        "VP", "VPBar",
+        "VF", "VFBar",
+        "VA", "VABar",
+        "LV", "LVBar",
+        "Gep", "GepBar",
+};
+
+
+CFLRGrammar CFLRGrammar::pointsTo()
+{
+    CFLRGrammar g;
+    g.addUnary(PT, AddrBar);
+    g.addBinary(PT, CopyBar, PT);
+    g.addBinary(PV, Store, PT);
+    g.addBinary(VP, PTBar, Load);
+    g.addBinary(Copy, PV, VP);
+    g.addInverse(PT, PTBar);
+    g.addInverse(Copy, CopyBar);
+    return g;
+}
+
+
+void CFLRGrammar::addUnary(EdgeLabel head, EdgeLabel body)
+{
+    unaryHeads[body].push_back(head);
+}
+
+
+void CFLRGrammar::addBinary(EdgeLabel head, EdgeLabel left, EdgeLabel right)
+{
+    leftTable[left].push_back({right, head});
+    rightTable[right].push_back({left, head});
+    binaryList.push_back({head, left, right});
+}
+
+
+void CFLRGrammar::addInverse(EdgeLabel label, EdgeLabel inverse)
+{
+    inverses[label] = inverse;
+}
+
+
+bool CFLRGrammar::load(const std::string &fileName)
+{
+    std::ifstream inFile(fileName);
+    if (!inFile)
+    {
+        std::cout << "error opening " + fileName + "!!\n";
+        return false;
+    }
+
+    std::string line;
+    unsigned lineNo = 0;
+    while (std::getline(inFile, line))
+    {
+        ++lineNo;
+        std::istringstream words(line);
+        std::vector<std::string> tokens;
+        for (std::string word; words >> word;)
+            tokens.push_back(word);
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+
+        // Either "inverse A Abar" or "A -> B [C]"
+        bool inversion = tokens[0] == "inverse";
+        bool wellFormed = inversion ? tokens.size() == 3 : tokens.size() >= 3 && tokens.size() <= 4 && tokens[1] == "->";
+        std::vector<EdgeLabel> labels;
+        for (size_t i = 0; wellFormed && i < tokens.size(); ++i)
+        {
+            if ((i == 0 && inversion) || (i == 1 && !inversion))
+                continue;
+            labels.push_back(labelByName(tokens[i]));
+            wellFormed = labels.back() != NoLabel;
+        }
+        if (!wellFormed)
+        {
+            std::cout << fileName << ":" << lineNo << ": malformed production '" << line << "'\n";
+            return false;
+        }
+
+        if (inversion)
+            addInverse(labels[0], labels[1]);
+        else if (labels.size() == 2)
+            addUnary(labels[0], labels[1]);
+        else
+            addBinary(labels[0], labels[1], labels[2]);
+    }
+    return true;
+}
+
+
+const char *CFLRGrammar::labelName(EdgeLabel label)
+{
+    return label < NumEdgeLabels ? labelNames[label] : "?";
+}
+
+
+EdgeLabel CFLRGrammar::labelByName(const std::string &name)
+{
+    for (EdgeLabel label = 0; label < NumEdgeLabels; ++label)
+        if (name == labelNames[label])
+            return label;
+    return NoLabel;
+}
@@ -6,7 +6,16 @@
 #ifndef ANSWERS_A4HEADER_H
 #define ANSWERS_A4HEADER_H
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <utility>
+#include <vector>
 
 #include "SVF-LLVM/SVFIRBuilder.h"
 
@@ -25,6 +34,31 @@ enum EdgeLabelType
     VF, VFBar,
     VA, VABar,
     LV, LVBar,
+    Gep, GepBar,    ///< base of the field-indexed labels Gep_k, see CFLRGraph::internLabel
+};
+
+/// The number of labels in EdgeLabelType
+constexpr unsigned NumEdgeLabels = GepBar + 1;
+
+/// Room for the labels of EdgeLabelType and the field-indexed labels interned after them.
+/// Every label stays below 255, so that an edge fits into a 64-bit key.
+constexpr unsigned MaxEdgeLabels = 254;
+
+/// The largest field index of a field-sensitive run: a field takes at most 8 interned labels
+/// (Gep_k, PT_k, PV_k, VP_k and their Bar labels)
+constexpr unsigned MaxFieldLimit = (MaxEdgeLabels - NumEdgeLabels) / 8;
+
+/**
+ * Storage backends of CFLRGraph.
+ * Both keep one bit-vector per (node, label) with neighbours, which takes most of their memory.
+ * Dense adds a slot per node on every used label, in both directions, so it takes more memory than HashMap
+ * unless most nodes have neighbours along most labels, in exchange for lookups without hashing.
+ * HashMap is the default.
+ */
+enum class CFLRStorage
+{
+    HashMap,    ///< per-label hash maps from node to neighbours, allocated on demand
+    Dense,      ///< per-label arrays indexed by node ID, holding one sparse bit-vector per (node, label)
 };
 
 
@@ -52,6 +86,18 @@ struct CFLREdge
     {
         return (src == rhs.src) && (dst == rhs.dst) && (label == rhs.label);
     }
+
+    /// Bits of src, dst and label in key()
+    static constexpr unsigned NodeBits = 28;
+    static constexpr unsigned LabelBits = 8;
+
+    /// Pack the edge into 64 bits (node IDs below 2^28, labels below 255)
+    inline uint64_t key() const
+    {
+        assert(src < (1u << NodeBits) && dst < (1u << NodeBits) && label < (1u << LabelBits) - 1 &&
+               "edge does not fit into a 64-bit key");
+        return ((uint64_t) src << (NodeBits + LabelBits)) | ((uint64_t) dst << LabelBits) | label;
+    }
 };
 
 
@@ -59,7 +105,11 @@ template<>
 struct std::hash<CFLREdge>
 {
     size_t operator()(const CFLREdge &edge) const
-    { return ((uint64_t) edge.src << 32) | (uint64_t) edge.dst; }
+    {
+        // All labels of a (src, dst) pair must land in different buckets
+        uint64_t h = (((uint64_t) edge.src << 32) | (uint64_t) edge.dst) * 0x9E3779B97F4A7C15ULL + edge.label;
+        return h ^ (h >> 32);
+    }
 };
 
 
@@ -69,11 +119,34 @@ struct std::hash<CFLREdge>
 class CFLRGraph
 {
 public:
-    /// We use a source -> label -> target map to represent the adjacency list of the predecessors/successors of nodes.
-    using DataMap = std::unordered_map<unsigned, std::unordered_map<EdgeLabel, std::unordered_set<unsigned>>>;
+    /// The neighbours of a node along one label
+    using NodeSet = SVF::NodeBS;
+    /// We use a label -> source -> target map to represent the adjacency list of the predecessors/successors of nodes.
+    /// The label is an array index, so only the node is hashed.
+    using DataMap = std::array<std::pmr::unordered_map<unsigned, NodeSet>, MaxEdgeLabels>;
+    /// We use a label -> node -> neighbours array to represent the adjacency list in the dense storage.
+    /// SVF node IDs are dense, so each label owns one slot per node and is allocated on its first use.
+    /// A slot is only a pointer: its set is allocated when the first neighbour is inserted.
+    using DenseMap = std::array<std::pmr::vector<std::unique_ptr<NodeSet>>, MaxEdgeLabels>;
+
+    /**
+     * Construct a graph from a PAG
+     * @param fieldLimit keep Gep statements as Gep_k edges for fields up to the limit (see gepLabel);
+     * 0 drops them, as in a field-insensitive run
+     */
+    explicit CFLRGraph(SVF::SVFIR *pag, CFLRStorage storage = CFLRStorage::HashMap, unsigned fieldLimit = 0);
 
-    /// Construct a graph from a PAG
-    explicit CFLRGraph(SVF::SVFIR *pag);
+    /// Construct an empty graph for node IDs below numNodes
+    CFLRGraph(unsigned numNodes, CFLRStorage storage);
+
+    /**
+     * Insert many edges at once: they are radix-sorted by node and label, and every set is filled in one pass,
+     * with the storage sized up front.  The graph constructors build through this path.
+     */
+    void addEdges(const CFLREdge *edges, size_t numEdges);
+
+    inline void addEdges(const std::vector<CFLREdge> &edges)
+    { addEdges(edges.data(), edges.size()); }
 
     /**
      * Check whether an edge is already in the graph
@@ -82,7 +155,8 @@ public:
      * @param label the label of the edge
      * @return true of the edge already exists, false otherwise
      */
-    bool hasEdge(unsigned src, unsigned dst, EdgeLabel label);
+    inline bool hasEdge(unsigned src, unsigned dst, EdgeLabel label) const
+    { return successors(src, label).test(dst); }
 
     /**
      * Add an edge to the graph
@@ -90,64 +164,746 @@ public:
      * @param dst the target node of the edge
      * @param label the label of the edge
      */
-    void addEdge(unsigned src, unsigned dst, EdgeLabel label);
+    inline void addEdge(unsigned src, unsigned dst, EdgeLabel label)
+    { insertIfAbsent(src, dst, label); }
+
+    /**
+     * Add an edge to the graph unless it is already there.
+     * The successor set is tested and updated in one step; the predecessor set is only touched for new edges.
+     * @param src the source node of the edge
+     * @param dst the target node of the edge
+     * @param label the label of the edge
+     * @return true if the edge is new, false if it already existed
+     */
+    inline bool insertIfAbsent(unsigned src, unsigned dst, EdgeLabel label)
+    {
+        if (!insertSuccessor(src, dst, label))
+            return false;
+        insertPredecessor(src, dst, label);
+        return true;
+    }
+
+    /// The successor half of insertIfAbsent: add dst to the successors of src, return true if it is new
+    inline bool insertSuccessor(unsigned src, unsigned dst, EdgeLabel label)
+    {
+        if (mirroredBars[label])
+            return insertInto(densePred, predMap, src, label ^ 1, dst);
+        return insertInto(denseSucc, succMap, src, label, dst);
+    }
+
+    /// The predecessor half of insertIfAbsent: add src to the predecessors of dst
+    inline void insertPredecessor(unsigned src, unsigned dst, EdgeLabel label)
+    {
+        if (mirroredBars[label])
+            insertInto(denseSucc, succMap, dst, label ^ 1, src);
+        else
+            insertInto(densePred, predMap, dst, label, src);
+    }
+
+    /// Remove an edge from the graph, return false if it was not there
+    bool removeEdge(unsigned src, unsigned dst, EdgeLabel label);
+
+    /**
+     * Stop storing the given Bar labels: an edge u --XBar--> v is then read from the edge v --X--> u,
+     * i.e. the successors along XBar are the predecessors along X, and inserting either one inserts both.
+     * Only sound for Bar labels whose edges are exactly the reversed edges of their twin, which CFLR::solve
+     * checks against the grammar.  Stored Bar edges are folded into their twin and freed.
+     * @param bars flags the odd (Bar) labels to mirror
+     */
+    void mirrorBars(const std::array<bool, MaxEdgeLabels> &bars);
+
+    /// Whether a label is answered from the reversed edges of its twin, see mirrorBars
+    inline bool isMirrored(EdgeLabel label) const
+    { return mirroredBars[label]; }
+
+    /**
+     * The successors of a node along a label.
+     * The dense storage answers with two array lookups; the hash storage probes the node once.
+     * The reference stays valid while edges between known nodes are added.
+     */
+    inline const NodeSet &successors(unsigned node, EdgeLabel label) const
+    {
+        if (mirroredBars[label])
+            return storedPredecessors(node, label ^ 1);
+        return storage == CFLRStorage::Dense ? denseAt(denseSucc, node, label) : hashedAt(succMap, node, label);
+    }
+
+    /// The predecessors of a node along a label
+    inline const NodeSet &predecessors(unsigned node, EdgeLabel label) const
+    {
+        if (mirroredBars[label])
+            return storage == CFLRStorage::Dense ? denseAt(denseSucc, node, label ^ 1)
+                                                 : hashedAt(succMap, node, label ^ 1);
+        return storedPredecessors(node, label);
+    }
+
+    /**
+     * The label of a base label parameterized by a field index, e.g. PT_2, interned on first use.
+     * The pair (base, field) is packed into one key (see packLabel) and mapped to the next free label,
+     * so the storage stays indexed by compact labels.  Labels are interned in pairs: for an even base
+     * X, the label of XBar_k is the one of X_k ^ 1.  Field 0 stands for the base label itself.
+     */
+    EdgeLabel internLabel(EdgeLabel base, unsigned field);
+
+    /// The label of base parameterized by field, or CFLRGrammar::NoLabel if it is not interned
+    EdgeLabel findLabel(EdgeLabel base, unsigned field) const;
+
+    /// The label of a Gep statement with the given field (negative if not a constant): Gep_k, with k
+    /// clamped to fieldLimit, or Copy for field 0 and variant offsets, which keep the object of the base
+    EdgeLabel gepLabel(int64_t field, unsigned fieldLimit);
+
+    static inline uint32_t packLabel(EdgeLabel base, unsigned field)
+    { return field << CFLREdge::LabelBits | base; }
+
+    /// The label of EdgeLabelType a label is parameterized from
+    inline EdgeLabel baseOf(EdgeLabel label) const
+    { return label < NumEdgeLabels ? label : fieldLabels[label - NumEdgeLabels] & ((1u << CFLREdge::LabelBits) - 1); }
+
+    /// The field index of a label, 0 for the labels of EdgeLabelType
+    inline unsigned fieldOf(EdgeLabel label) const
+    { return label < NumEdgeLabels ? 0 : fieldLabels[label - NumEdgeLabels] >> CFLREdge::LabelBits; }
+
+    /// One more than the largest label in use
+    inline unsigned getLabelNum() const
+    { return NumEdgeLabels + fieldLabels.size(); }
+
+    /// The name of a label, with its field index appended as in PT_2
+    std::string labelName(EdgeLabel label) const;
+
+    /// Visit every edge of the graph as fn(src, dst, label), mirrored Bar edges included
+    template<typename Fn>
+    void forEachEdge(Fn fn)
+    {
+        for (EdgeLabel label = 0; label < getLabelNum(); ++label)
+        {
+            // A mirrored label is stored as the reversed edges of its twin
+            bool mirrored = mirroredBars[label];
+            EdgeLabel stored = mirrored ? label ^ 1 : label;
+            auto visit = [&](unsigned src, unsigned dst) {
+                if (mirrored)
+                    fn(dst, src, label);
+                else
+                    fn(src, dst, label);
+            };
+            if (storage == CFLRStorage::Dense)
+            {
+                for (unsigned src = 0; src < denseSucc[stored].size(); ++src)
+                    if (denseSucc[stored][src])
+                        for (unsigned dst : *denseSucc[stored][src])
+                            visit(src, dst);
+            }
+            else
+            {
+                for (auto &nodeItr : succMap[stored])
+                    for (unsigned dst : nodeItr.second)
+                        visit(nodeItr.first, dst);
+            }
+        }
+    }
+
+    CFLRStorage getStorage() const
+    { return storage; }
+
+    /// An upper bound of the node IDs in the graph
+    unsigned getNodeNum() const
+    { return numNodes; }
+
+    /// The representative of a node: itself unless it was merged into another node by collapseCycles.
+    /// Compresses the path it walks, so it must not run concurrently with itself.
+    inline unsigned rep(unsigned node) const
+    {
+        unsigned root = node;
+        while (root < parents.size() && parents[root] != root)
+            root = parents[root];
+        while (node != root)
+        {
+            unsigned next = parents[node];
+            parents[node] = root;
+            node = next;
+        }
+        return root;
+    }
+
+    /// Whether collapseCycles has merged any node
+    inline bool hasMergedNodes() const
+    { return !parents.empty(); }
+
+    /**
+     * Detect the strongly connected components formed by edges of one label and merge each component into
+     * its smallest node.  All edges of a merged node, of every label, are moved to the representative.
+     * For the points-to grammar, the members of a Copy cycle have identical points-to sets, so the result
+     * is expanded back to all members when it is dumped.
+     * @param label the label whose cycles are collapsed
+     * @param changed receives the representatives that absorbed other nodes
+     * @return the number of merged (non-representative) nodes
+     */
+    unsigned collapseCycles(EdgeLabel label, std::vector<unsigned> &changed);
+
+    /**
+     * Like collapseCycles above, but only for the components reachable from the given roots.
+     * A new edge u -> v closes a cycle only if the component of u is reachable from u, so the sources
+     * of the edges added since the last collapse suffice as roots; the rest of the graph is not visited.
+     */
+    unsigned collapseCycles(EdgeLabel label, const std::vector<unsigned> &roots, std::vector<unsigned> &changed);
+
+    /**
+     * Strongly connected components over the edges of one label.
+     * Components are numbered in reverse topological order: no edge leads from a component to a later one.
+     * @param sccOf receives the component of each node
+     * @return the number of components
+     */
+    unsigned findSCCs(EdgeLabel label, std::vector<unsigned> &sccOf) const;
+
+    /**
+     * Allocate the label arrays of the dense storage up front, for the given labels and those already in use.
+     * Afterwards insertions between known nodes along these labels never reallocate, so they may run
+     * concurrently on distinct nodes; the sets themselves are still allocated on first insert.
+     * @param labels flags the labels that will be inserted into
+     */
+    void allocateDense(const std::array<bool, MaxEdgeLabels> &labels);
+
+protected:
+    /// Move every edge of node to rep and record rep as its representative
+    void mergeInto(unsigned node, unsigned rep);
+
+    /// Tarjan's algorithm over the edges of one label, from the given roots.  Calls onSCC with the members
+    /// of every component reached, in reverse topological order.
+    void visitSCCs(EdgeLabel label, const std::vector<unsigned> &roots,
+                   const std::function<void(const std::vector<unsigned> &)> &onSCC) const;
+
+    /// Make room for node IDs up to (and including) node in every allocated label
+    void growDense(unsigned node);
+
+    /// Return the bit-vector of (node, label), allocating the label and the set on their first use
+    NodeSet &denseSet(DenseMap &map, unsigned node, EdgeLabel label);
+
+    /// Add elem to the stored set of (node, label) in one direction, return true if it is new
+    bool insertInto(DenseMap &dense, DataMap &hashed, unsigned node, EdgeLabel label, unsigned elem);
+
+    inline const NodeSet &storedPredecessors(unsigned node, EdgeLabel label) const
+    { return storage == CFLRStorage::Dense ? denseAt(densePred, node, label) : hashedAt(predMap, node, label); }
+
+    static const NodeSet &denseAt(const DenseMap &map, unsigned node, EdgeLabel label)
+    {
+        const auto &sets = map[label];
+        return node < sets.size() && sets[node] ? *sets[node] : emptySet;
+    }
+
+    static const NodeSet &hashedAt(const DataMap &map, unsigned node, EdgeLabel label)
+    {
+        auto nodeItr = map[label].find(node);
+        return nodeItr == map[label].end() ? emptySet : nodeItr->second;
+    }
+
+    static const NodeSet emptySet;  // returned for (node, label) pairs without neighbours
+
+    /// A label array whose containers allocate from the given resource
+    template<class LabelArray, size_t... Labels>
+    static LabelArray onArena(std::pmr::memory_resource *arena, std::index_sequence<Labels...>)
+    { return {{((void) Labels, typename LabelArray::value_type(arena))...}}; }
+
+    template<class LabelArray>
+    static LabelArray onArena(std::pmr::memory_resource *arena)
+    { return onArena<LabelArray>(arena, std::make_index_sequence<MaxEdgeLabels>()); }
+
+    CFLRStorage storage;
+    unsigned numNodes;  // node IDs covered by every allocated label of the dense storage
+    mutable std::vector<unsigned> parents;  // union-find over merged nodes, empty until a node is merged
+    // The Tarjan index and low link of each node, kept between visitSCCs calls so that a call only costs the
+    // nodes it visits; Unvisited outside of a call
+    mutable std::vector<unsigned> sccIndex;
+    mutable std::vector<unsigned> sccLowLink;
+    std::array<bool, MaxEdgeLabels> mirroredBars{};    // Bar labels read from their twin, see mirrorBars
+    std::vector<uint32_t> fieldLabels;  // packed (base, field) of the labels from NumEdgeLabels on
+    std::unordered_map<uint32_t, EdgeLabel> fieldLabelIds;  // packed (base, field) -> label, for even bases
+
+    // The hash nodes, buckets and label arrays live until the graph is deleted, which frees the pools at once.
+    // The sets themselves (SVF::NodeBS) take no allocator.  The parallel solver allocates nothing from the
+    // graph once its arrays are allocated, so the pool needs no synchronisation.
+    std::pmr::unsynchronized_pool_resource arena;
+
+    DataMap predMap = onArena<DataMap>(&arena);   // holding predecessors
+    DataMap succMap = onArena<DataMap>(&arena);   // holding successors
+
+    DenseMap densePred = onArena<DenseMap>(&arena);   // holding predecessors (dense storage)
+    DenseMap denseSucc = onArena<DenseMap>(&arena);   // holding successors (dense storage)
+};
+
+
+/**
+ * A normalised context-free grammar over edge labels, compiled into per-label lookup tables.
+ * Productions are unary (A -> B) or binary (A -> B C).  An inversion (A, Abar) says that every
+ * derived A edge u -> v also yields the edge v -> u labelled Abar.
+ */
+class CFLRGrammar
+{
+public:
+    /// Marks a label without inverse
+    static constexpr EdgeLabel NoLabel = ~0u;
+
+    /// A table entry: combined with an edge labelled `other`, the edge being looked up yields `head`
+    struct Entry
+    {
+        EdgeLabel other;
+        EdgeLabel head;
+    };
+
+    /// A binary production head -> left right
+    struct Binary
+    {
+        EdgeLabel head;
+        EdgeLabel left;
+        EdgeLabel right;
+    };
+
+    CFLRGrammar()
+    { inverses.fill(NoLabel); }
+
+    /// The grammar of the points-to analysis solved by default
+    static CFLRGrammar pointsTo();
+
+    /**
+     * Load productions from a file, one per line, using the names of EdgeLabelType:
+     *   PT -> AddrBar          (unary)
+     *   PT -> CopyBar PT       (binary)
+     *   inverse PT PTBar       (inversion)
+     * Empty lines and lines starting with '#' are ignored.
+     * @return false if the file cannot be read or a line is malformed
+     */
+    bool load(const std::string &fileName);
+
+    void addUnary(EdgeLabel head, EdgeLabel body);
+    void addBinary(EdgeLabel head, EdgeLabel left, EdgeLabel right);
+    void addInverse(EdgeLabel label, EdgeLabel inverse);
+
+    /// The heads of the unary productions with the given body
+    inline const std::vector<EdgeLabel> &unary(EdgeLabel body) const
+    { return unaryHeads[body]; }
+
+    /// The binary productions with `label` as left operand; `other` is the right operand
+    inline const std::vector<Entry> &asLeft(EdgeLabel label) const
+    { return leftTable[label]; }
+
+    /// The binary productions with `label` as right operand; `other` is the left operand
+    inline const std::vector<Entry> &asRight(EdgeLabel label) const
+    { return rightTable[label]; }
+
+    /// The inverse of a derived label, or NoLabel
+    inline EdgeLabel inverse(EdgeLabel label) const
+    { return inverses[label]; }
+
+    /// All binary productions, in insertion order
+    inline const std::vector<Binary> &binaries() const
+    { return binaryList; }
+
+    /// The name of a label of EdgeLabelType, as used in grammar files
+    static const char *labelName(EdgeLabel label);
+    /// The label of a name, or NoLabel
+    static EdgeLabel labelByName(const std::string &name);
+
+protected:
+    std::array<std::vector<EdgeLabel>, MaxEdgeLabels> unaryHeads;
+    std::array<std::vector<Entry>, MaxEdgeLabels> leftTable;
+    std::array<std::vector<Entry>, MaxEdgeLabels> rightTable;
+    std::array<EdgeLabel, MaxEdgeLabels> inverses;
+    std::vector<Binary> binaryList;
+};
+
+
+/**
+ * Fixpoint algorithms of CFLR::solve
+ */
+/// The order in which the worklist solver processes edges, see CFLRWorkList
+enum class CFLRSchedule
+{
+    FIFO,
+    LIFO,
+    LabelPriority,  ///< edges of the points-to core (Addr, PT and their Bar edges) first
+    NodeLocality,   ///< all queued edges of one source node in a row
+    Topological     ///< sources in topological order of the DAG of Copy SCCs
+};
+
+/// A solver whose requirement is not met is replaced by the worklist solver, with a warning
+enum class CFLRSolver
+{
+    WorkList,   ///< pop one edge at a time from a FIFO worklist and join it with its neighbours
+    SemiNaive,  ///< difference propagation: each round joins only the edges derived in the previous round
+    Parallel,   ///< worklist algorithm on several threads, sharded by source node (dense storage only)
+    SharedSets, ///< points-to sets as shared, hash-consed bit-vectors joined by cached unions (points-to grammar only)
+};
+
+
+/**
+ * Settings of a CFLR run
+ */
+struct CFLROptions
+{
+    CFLRStorage storage = CFLRStorage::HashMap;
+    CFLRSolver solver = CFLRSolver::WorkList;
+    unsigned threads = 0;   ///< threads of the parallel solver, 0 for one per hardware thread
+    bool collapseCycles = false;    ///< merge Copy cycles before (and, for the worklist solver, while) solving
+    unsigned collapsePeriod = 1 << 12;  ///< new Copy edges after which the worklist solver collapses cycles again
+    unsigned queryBudget = 1000000; ///< propagation steps one demand-driven query may take
+    CFLRSchedule schedule = CFLRSchedule::FIFO; ///< edge order of the worklist solver
+    bool incremental = false;   ///< keep the initial edges, as required by CFLR::removeInitialEdges
+    bool mirrorBars = false;    ///< store the Bar edges the grammar allows only once, see CFLRGraph::mirrorBars
+    unsigned fieldLimit = 0;    ///< field-sensitive Gep edges for fields up to the limit, 0 drops Gep statements
+};
+
+
+/**
+ * Counters of a fixpoint run
+ */
+struct CFLRCounters
+{
+    uint64_t pushes = 0;        ///< edges put on the worklist
+    uint64_t pops = 0;          ///< edges taken from the worklist
+    uint64_t duplicates = 0;    ///< derivations of edges already in the graph
+    uint64_t maxWorkList = 0;   ///< largest number of edges waiting at once
+    uint64_t unions = 0;        ///< set unions of the shared-set solver
+    uint64_t unionHits = 0;     ///< unions answered by the union cache
+    std::array<uint64_t, MaxEdgeLabels> derived{};  ///< new edges per label
+
+    /// Merge the counters of another thread
+    CFLRCounters &operator+=(const CFLRCounters &other);
+};
+
+
+/**
+ * Wall time and peak RSS of the phases of a run, together with the solver counters.
+ * Phases are delimited by startPhase/endPhase and written to a JSON file by dump().
+ */
+class CFLRStats
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        double seconds;
+        long peakRSSKiB;    ///< peak resident set size of the process at the end of the phase
+    };
 
-    DataMap &getSuccessorMap()
-    { return succMap; }
+    CFLRCounters counters;
 
-    DataMap &getPredecessorMap()
-    { return predMap; }
+    void startPhase(const std::string &name);
+    void endPhase();
+
+    const std::vector<Phase> &getPhases() const
+    { return phases; }
+
+    bool dump(const std::string &fileName) const;
 
 protected:
-    DataMap predMap;   // holding predecessors
-    DataMap succMap;   // holding successors
+    std::vector<Phase> phases;
+    std::chrono::steady_clock::time_point phaseStart;
+};
+
+
+/**
+ * Selects what CFLR::dumpGraph writes
+ */
+struct CFLRDumpFilter
+{
+    bool dot = false;           ///< Graphviz DOT instead of a "src dst label" edge list
+    std::vector<bool> labels;   ///< labels to write, indexed by label; empty for all
+    unsigned minNode = 0;       ///< only edges with both ends in [minNode, maxNode]
+    unsigned maxNode = ~0u;
+
+    bool accepts(unsigned src, unsigned dst, EdgeLabel label) const
+    {
+        return (labels.empty() || (label < labels.size() && labels[label])) &&
+               src >= minNode && src <= maxNode && dst >= minNode && dst <= maxNode;
+    }
 };
 
 
 /**
- * FIFO worklist
+ * FIFO worklist without per-element allocations.
+ * Elements are kept in a ring buffer, and duplicates are filtered by an open-addressing set of their
+ * 64-bit keys (T::key()) with linear probing and backward-shift deletion.
  */
 template<class T>
-class WorkList
+class FlatWorkList
 {
 public:
     /// Check whether the worklist is empty.
     inline bool empty() const
-    { return data_list.empty(); }
+    { return count == 0; }
+
+    /// The number of elements in the worklist.
+    inline size_t size() const
+    { return count; }
 
     /// Clear the worklist
     inline void clear()
     {
-        data_list.clear();
-        data_set.clear();
+        std::fill(slots.begin(), slots.end(), EmptyKey);
+        head = 0;
+        count = 0;
     }
 
     /// Push a data into the END work list.
     inline bool push(const T &data)
     {
-        if (data_set.find(data) == data_set.end())
+        if ((count + 1) * 2 > slots.size())
+            grow();
+        uint64_t key = data.key();
+        size_t mask = slots.size() - 1;
+        size_t i = slot(key);
+        while (slots[i] != EmptyKey)
         {
-            this->data_list.push_back(data);
-            this->data_set.insert(data);
-            return true;
+            if (slots[i] == key)
+                return false;
+            i = (i + 1) & mask;
         }
-        else
-            return false;
+        slots[i] = key;
+        if (ring.size() != slots.size())
+            ring.resize(slots.size(), data);
+        ring[(head + count) & mask] = data;
+        ++count;
+        return true;
     }
 
     /// Pop a data from the FRONT of work list.
     inline T pop()
     {
         assert(!this->empty() && "work list is empty");
-        T data = this->data_list.front();
-        this->data_list.pop_front();
-        this->data_set.erase(data);
+        size_t mask = slots.size() - 1;
+        T data = ring[head];
+        head = (head + 1) & mask;
+        --count;
+        erase(data.key());
         return data;
     }
 
+    /// Pop a data from the END of work list.
+    inline T popBack()
+    {
+        assert(!this->empty() && "work list is empty");
+        size_t mask = slots.size() - 1;
+        T data = ring[(head + count - 1) & mask];
+        --count;
+        erase(data.key());
+        return data;
+    }
+
+protected:
+    static constexpr uint64_t EmptyKey = ~0ULL;
+
+    inline size_t slot(uint64_t key) const
+    {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        return key & (slots.size() - 1);
+    }
+
+    /// Remove a key and shift the following entries of its probe run back, so that no tombstones are needed
+    inline void erase(uint64_t key)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = slot(key);
+        while (slots[i] != key)
+            i = (i + 1) & mask;
+        size_t j = i;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (slots[j] == EmptyKey)
+                break;
+            size_t home = slot(slots[j]);
+            // Move slots[j] into the hole unless its home lies cyclically in (i, j]
+            if (((j - home) & mask) >= ((j - i) & mask))
+            {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = EmptyKey;
+    }
+
+    /// Double the capacity (both the ring and the set share one power-of-two size)
+    void grow()
+    {
+        size_t oldSize = slots.size();
+        size_t newSize = oldSize ? oldSize * 2 : 64;
+        std::vector<T> newRing;
+        newRing.reserve(newSize);
+        for (size_t i = 0; i < count; ++i)
+            newRing.push_back(ring[(head + i) & (oldSize - 1)]);
+        // T needs no default constructor: the unused part of the ring holds copies of some element
+        if (!ring.empty())
+            newRing.resize(newSize, ring[head]);
+        std::vector<uint64_t> oldSlots(newSize, EmptyKey);
+        oldSlots.swap(slots);
+        ring.swap(newRing);
+        head = 0;
+        size_t mask = newSize - 1;
+        for (uint64_t key : oldSlots)
+        {
+            if (key == EmptyKey)
+                continue;
+            size_t i = slot(key);
+            while (slots[i] != EmptyKey)
+                i = (i + 1) & mask;
+            slots[i] = key;
+        }
+    }
+
+    std::vector<uint64_t> slots;    ///< open-addressing set of the keys in the worklist
+    std::vector<T> ring;            ///< ring buffer holding the elements in FIFO order
+    size_t head = 0;                ///< index of the front element in the ring
+    size_t count = 0;               ///< number of elements in the worklist
+};
+
+
+/**
+ * The worklist of the worklist solver, ordered by a CFLRSchedule.
+ * FIFO and LIFO use one FlatWorkList.  The priority schedules keep one FlatWorkList per priority and pop from the
+ * first non-empty one.  NodeLocality queues the edges of each source node together and drains one node at a time;
+ * it filters no duplicates, which only cost redundant work since the solver pushes new edges only.
+ * Every schedule reaches the same fixpoint.
+ */
+class CFLRWorkList
+{
+public:
+    /// Select the schedule; Topological needs the position of every node in the topological order
+    void setSchedule(CFLRSchedule schedule, std::vector<unsigned> topoRank = std::vector<unsigned>());
+
+    inline bool empty() const
+    { return count == 0; }
+
+    inline size_t size() const
+    { return count; }
+
+    void clear();
+
+    /// Push an edge; false if it is already in the worklist
+    inline bool push(const CFLREdge &edge)
+    {
+        bool pushed;
+        switch (schedule)
+        {
+        case CFLRSchedule::FIFO:
+        case CFLRSchedule::LIFO:
+            pushed = buckets[0].push(edge);
+            break;
+        case CFLRSchedule::NodeLocality:
+            pushLocal(edge);
+            pushed = true;
+            break;
+        default:
+        {
+            unsigned b = priority(edge);
+            pushed = buckets[b].push(edge);
+            first = std::min(first, b);
+        }
+        }
+        count += pushed;
+        return pushed;
+    }
+
+    inline CFLREdge pop()
+    {
+        assert(!empty() && "work list is empty");
+        --count;
+        switch (schedule)
+        {
+        case CFLRSchedule::FIFO:
+            return buckets[0].pop();
+        case CFLRSchedule::LIFO:
+            return buckets[0].popBack();
+        case CFLRSchedule::NodeLocality:
+            return popLocal();
+        default:
+            while (buckets[first].empty())
+                ++first;
+            return buckets[first].pop();
+        }
+    }
+
 protected:
-    std::unordered_set<T> data_set;       ///< to avoid duplicate elements
-    std::deque<T> data_list;     ///< to access the elements at both the beginning and the end
+    /// Topological ranks are spread over this many buckets
+    static constexpr unsigned TopoBuckets = 256;
+    static constexpr unsigned NoNode = ~0u;
+
+    inline unsigned priority(const CFLREdge &edge) const
+    {
+        if (schedule == CFLRSchedule::LabelPriority)
+            return edge.label < labelRank.size() ? labelRank[edge.label] : labelRank.back();
+        if (edge.src >= topoRank.size())
+            return TopoBuckets - 1;
+        return (uint64_t) topoRank[edge.src] * TopoBuckets / topoRank.size();
+    }
+
+    void pushLocal(const CFLREdge &edge);
+    CFLREdge popLocal();
+
+    CFLRSchedule schedule = CFLRSchedule::FIFO;
+    size_t count = 0;
+    std::vector<FlatWorkList<CFLREdge>> buckets = std::vector<FlatWorkList<CFLREdge>>(1);
+    unsigned first = 0;                 ///< no bucket before it holds an edge
+    std::vector<unsigned> labelRank;    ///< LabelPriority: the bucket of each label
+    std::vector<unsigned> topoRank;     ///< Topological: the position of each node
+    std::pmr::unsynchronized_pool_resource pool;    ///< NodeLocality: the per-node queues
+    std::pmr::vector<std::pmr::vector<CFLREdge>> byNode{&pool};   ///< NodeLocality: the queued edges of each node
+    std::vector<bool> nodeQueued;
+    std::pmr::deque<unsigned> nodes{&pool};     ///< NodeLocality: nodes with queued edges, in FIFO order
+    unsigned current = NoNode;          ///< NodeLocality: the node being drained
+};
+
+
+/**
+ * Hash-consed points-to sets: every distinct set is stored once, under an ID, and never changes, so
+ * pointers with equal sets share one bit-vector and a growing set is replaced by the ID of the larger one
+ * (copy on write).  Unions are cached by the IDs of their operands.  Holders of an ID retain it; a set
+ * nobody retains any more is freed, and its ID is not reused, so cached unions never name another set.
+ */
+class PointsToSets
+{
+public:
+    using NodeSet = CFLRGraph::NodeSet;
+
+    /// The ID of the empty set
+    static constexpr unsigned Empty = 0;
+
+    PointsToSets();
+
+    /// The ID of a set, added to the table if it is new
+    unsigned intern(const NodeSet &set);
+
+    /// The set of an ID; the reference stays valid while sets are added
+    inline const NodeSet &get(unsigned id) const
+    { return sets[id]; }
+
+    /// The ID of the union of two sets
+    unsigned unite(unsigned a, unsigned b, CFLRCounters &counters);
+
+    inline void retain(unsigned id)
+    {
+        if (id != Empty)
+            ++refs[id];
+    }
+
+    /// Drop a reference, freeing the set once it has none left
+    void release(unsigned id);
+
+    /// The number of sets not freed
+    inline size_t size() const
+    { return numLive; }
+
+protected:
+    static uint64_t hash(const NodeSet &set);
+
+    /// The union cache is dropped when it grows beyond this many entries
+    static constexpr size_t MaxCachedUnions = 1 << 22;
+
+    std::deque<NodeSet> sets;
+    std::vector<unsigned> refs;     ///< ID -> holders of the set; Empty is never freed
+    std::vector<bool> freed;
+    size_t numLive = 0;
+    std::unordered_map<uint64_t, std::vector<unsigned>> byHash;
+    std::unordered_map<uint64_t, unsigned> unionCache;  ///< (smaller ID, larger ID) -> ID of the union
 };
 
 
@@ -156,22 +912,232 @@ protected:
  */
 class CFLR
 {
-    WorkList<CFLREdge> workList;
+    /// Memoised state of the demand-driven queries: a points-to / flows-to constraint system restricted to the
+    /// demanded pointers and objects, solved by propagating one new fact at a time
+    struct QueryCache
+    {
+        enum EventKind
+        { DemandPointer, DemandObject, NewPointsTo, NewFlowsTo };
+
+        struct Event
+        {
+            EventKind kind;
+            unsigned node;
+            unsigned elem;  ///< the object added to pt(node), or the pointer added to flowsTo(node)
+        };
+
+        using SetMap = std::unordered_map<unsigned, CFLRGraph::NodeSet>;
+
+        SetMap pointsTo;    ///< pointer -> objects
+        SetMap flowsTo;     ///< object -> pointers
+        SetMap copiesTo;    ///< pointer x -> pointers whose points-to set includes pt(x)
+        SetMap loadsTo;     ///< pointer u -> demanded pointers p with u --Load--> p
+        SetMap loadsFrom;   ///< object o -> demanded pointers loading from o
+        SetMap storesTo;    ///< pointer v -> objects having a pointer stored into *v in their flows-to set
+        SetMap storedInto;  ///< object o2 -> objects having a pointer stored into o2 in their flows-to set
+        CFLRGraph::NodeSet demandedPointers;
+        CFLRGraph::NodeSet demandedObjects;
+        std::deque<Event> events;   ///< facts not propagated yet, kept across queries
+    };
+
+    CFLRWorkList workList;
     CFLRGraph *graph;
+    CFLROptions options;
+    CFLRGrammar grammar;
+    QueryCache queries;
+    std::string moduleName;     // names the result files
+    CFLRStats stats;
+    std::unordered_set<CFLREdge> baseEdges;     ///< the initial edges, recorded by solve() if incremental
+    bool solved = false;
+    bool customGrammar = false;     ///< whether setGrammar replaced the points-to grammar
+    PointsToSets ptSets;            ///< the points-to sets of the shared-set solver
+    std::vector<unsigned> ptOf;     ///< node -> ID of its points-to set, if the shared-set solver ran
+    bool fieldProductions = false;  ///< whether addFieldProductions has run
 
 public:
-    CFLR() : graph(nullptr)
+    /// The options are fixed here and used by buildGraph and solve
+    explicit CFLR(const CFLROptions &options = CFLROptions()) :
+            graph(nullptr), options(options), grammar(CFLRGrammar::pointsTo())
     {}
 
     ~CFLR()
     { delete graph; }
 
+    /// Replace the default points-to grammar
+    void setGrammar(const CFLRGrammar &g)
+    {
+        grammar = g;
+        customGrammar = true;
+    }
+
     /// Build a graph from PAG
     void buildGraph(SVF::PAG *pag);
-    /// The dynamic-programming CFL-reachability algorithm.
+
+    /// Solve a graph built without a PAG, e.g. by a generator.  Takes ownership of the graph.
+    void setGraph(CFLRGraph *cflrGraph, const std::string &name)
+    {
+        delete graph;
+        graph = cflrGraph;
+        moduleName = name;
+    }
+
+    /**
+     * The key of a graph snapshot: a hash of the contents of the input modules and of the options
+     * that influence the PAG (every option except the -cflr-* ones).
+     */
+    static uint64_t snapshotKey(const std::vector<std::string> &modules, int argc, char **argv);
+
+    /**
+     * Build the graph from the PAG of an SVFIR artifact, written by svfir, instead of from a module.
+     * Gep statements are kept or dropped according to CFLROptions::fieldLimit, as in buildGraph.
+     */
+    bool loadArtifact(const std::string &fileName);
+
+    /**
+     * Build the graph from a snapshot written by saveSnapshot, instead of from a PAG.
+     * The labelled edges are sorted into the storage straight from the memory-mapped file.
+     * @return false if the file is missing, malformed or was written for another key
+     */
+    bool loadSnapshot(const std::string &fileName, uint64_t key);
+
+    /// Save the initial graph (call before solve) to a snapshot file
+    bool saveSnapshot(const std::string &fileName, uint64_t key);
+    /// The dynamic-programming CFL-reachability algorithm, run with the selected solver.
     void solve();
-    /// Dump results into a file
+    /// The points-to set of a node once solved, whichever solver found it
+    const CFLRGraph::NodeSet &pointsTo(unsigned node) const;
+
+    /// Dump results into a file; a pointer into field k of an object o points to "o.k"
     void dumpResult();
+    /// Dump results into a binary file (<module>.res.bin, see A4Result.h), without the field pointers
+    void dumpBinaryResult();
+    /// Dump the edges of the current graph into <module>.<stage>.dot (or .edges)
+    void dumpGraph(const std::string &stage, const CFLRDumpFilter &filter);
+
+    /// Phase timings (recorded by the driver) and the counters of the last solve
+    CFLRStats &getStats()
+    { return stats; }
+
+    /**
+     * Demand-driven points-to query on the initial graph, without solving the whole program.
+     * Only the pointers and objects the query depends on are explored, backwards along Copy and Load edges
+     * and through the stores into the objects they point to.  Results are memoised across queries; a query
+     * that runs out of budget leaves its partial results behind for later queries to complete.
+     * The exploration follows the points-to grammar (CFLRGrammar::pointsTo), not a custom one, and no Gep edges.
+     * A node merged by collapseCycles is answered for its representative, like pointsTo.
+     * @param node the pointer to query
+     * @param pts receives the points-to set found so far
+     * @return true if pts is complete, false if the budget ran out first
+     */
+    bool queryPointsTo(unsigned node, CFLRGraph::NodeSet &pts);
+
+    /**
+     * Add initial edges to a solved graph and resume the fixpoint from the existing results.
+     * Edges are given as the CFLRGraph constructor adds them, i.e. a statement comes with its Bar edge.
+     * Before solve(), the edges just join the initial graph.
+     * @return false unless the solver was created with CFLROptions::incremental
+     */
+    bool addInitialEdges(const std::vector<CFLREdge> &batch);
+
+    /**
+     * Remove initial edges from a solved graph, keeping the results equal to those of a clean run.
+     * Uses DRed: every edge with a derivation through a removed edge is deleted, then the deleted edges that
+     * still have a derivation from the remaining ones are re-derived and the fixpoint is resumed.
+     * A graph with collapsed cycles is solved again from its initial edges instead, as merged nodes cannot
+     * be split again.
+     * @return false unless the solver was created with CFLROptions::incremental
+     */
+    bool removeInitialEdges(const std::vector<CFLREdge> &batch);
+
+    /**
+     * Apply a file of updates, a "+ src dst Label" or "- src dst Label" per line, after which consecutive
+     * lines of the same kind form one batch of addInitialEdges or removeInitialEdges.
+     * A statement (Addr, Copy, Store, Load) is updated together with its Bar edge, as the CFLRGraph
+     * constructor adds them, whichever of the two the line names; other labels are updated as given.
+     * @return false on an unreadable or malformed file, or a solver without CFLROptions::incremental
+     */
+    bool applyUpdates(const std::string &fileName);
+
+protected:
+    /// Queue an edge of the worklist solver
+    inline void pushEdge(const CFLREdge &edge)
+    {
+        if (workList.push(edge))
+        {
+            ++stats.counters.pushes;
+            stats.counters.maxWorkList = std::max<uint64_t>(stats.counters.maxWorkList, workList.size());
+        }
+    }
+
+    /// Run the worklist solver until the worklist is empty
+    void propagate();
+
+    /**
+     * The Bar labels whose edges are always the reversed edges of their twin X: XBar is derived by no
+     * production, and X either has XBar as its grammar inverse, or is a statement label (paired with its Bar
+     * edge by the graph constructor) that no production derives.
+     */
+    std::array<bool, MaxEdgeLabels> mirrorableBars() const;
+
+    /// The labels some production of the grammar derives
+    std::array<bool, MaxEdgeLabels> derivedLabels() const;
+
+    /**
+     * Instantiate the field-indexed productions for the Gep_j labels of the graph.  A pointer into field k
+     * of an object points to it along PT_k, where offsets add up along Gep edges, and a value flows from a
+     * store to a load only through the same field, as the matching parentheses Store PT_k ... PTBar_k Load:
+     *   PT_min(i+j,L) -> GepBar_j PT_i     PT_k -> CopyBar PT_k     inverse PT_k PTBar_k
+     *   PV_k -> Store PT_k     VP_k -> PTBar_k Load     Copy -> PV_k VP_k
+     * with PT_0 = PT and L = CFLROptions::fieldLimit; only the fields reachable from 0 are interned.
+     * Only the built-in grammar is extended, a grammar set by setGrammar is left as it is.
+     */
+    void addFieldProductions();
+
+    /// FIFO worklist algorithm
+    void solveWorkList();
+    /// Semi-naive (difference propagation) algorithm
+    void solveSemiNaive();
+    /// Multithreaded worklist algorithm
+    void solveParallel();
+    /// Inclusion-based solver over shared points-to sets, equivalent to the points-to grammar
+    void solveSharedSets();
+};
+
+
+/**
+ * Runs independent modules side by side, at most a number of jobs at a time and within a budget of
+ * estimated memory.  Jobs start largest first; a job that does not fit waits until enough memory is
+ * released, while smaller jobs may start in its place.  A job larger than the whole budget runs alone.
+ */
+class CFLRBatch
+{
+public:
+    /// Analyses one module; returns false if it failed
+    using Runner = std::function<bool(const std::string &input)>;
+
+    /// @param jobs concurrent jobs (0 for one per hardware thread)
+    /// @param memoryBudget bytes of estimated memory of the running jobs (0 for no limit)
+    CFLRBatch(unsigned jobs, uint64_t memoryBudget) :
+            jobs(jobs), memoryBudget(memoryBudget)
+    {}
+
+    /// Queue a module with the peak memory it is expected to take
+    void add(const std::string &input, uint64_t memory)
+    { pending.push_back({input, memory}); }
+
+    /// Run the queued modules; returns the number of failed ones
+    unsigned run(const Runner &runner);
+
+protected:
+    struct Job
+    {
+        std::string input;
+        uint64_t memory;
+    };
+
+    unsigned jobs;
+    uint64_t memoryBudget;
+    std::vector<Job> pending;
 };
 
 #endif //ANSWERS_A4HEADER_H
@@ -0,0 +1,206 @@
+/**
+ * A4Incremental.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <fstream>
+#include <sstream>
+
+bool CFLR::addInitialEdges(const std::vector<CFLREdge> &batch)
+{
+    if (!options.incremental)
+        return false;
+
+    for (const CFLREdge &edge : batch)
+    {
+        if (!solved)
+        {
+            graph->addEdge(edge.src, edge.dst, edge.label);
+            continue;
+        }
+        if (!baseEdges.insert(edge).second)
+            continue;
+        unsigned u = graph->rep(edge.src);
+        unsigned v = graph->rep(edge.dst);
+        // A mirrored Bar edge arrives with its twin, but is processed on its own
+        if (graph->insertIfAbsent(u, v, edge.label) || graph->isMirrored(edge.label))
+            pushEdge(CFLREdge(u, v, edge.label));
+    }
+
+    // Every new edge is joined with all existing ones; the old edges are closed among themselves already
+    if (solved)
+        propagate();
+    // The memoised queries know the graph without the new edges
+    queries = QueryCache();
+    return true;
+}
+
+
+bool CFLR::removeInitialEdges(const std::vector<CFLREdge> &batch)
+{
+    if (!options.incremental)
+        return false;
+
+    std::vector<CFLREdge> removed;
+    for (const CFLREdge &edge : batch)
+    {
+        if (!solved)
+            graph->removeEdge(edge.src, edge.dst, edge.label);
+        else if (baseEdges.erase(edge))
+            removed.push_back(edge);
+    }
+    if (removed.empty())
+        return true;
+
+    if (graph->hasMergedNodes())
+    {
+        CFLRGraph *fresh = new CFLRGraph(graph->getNodeNum(), graph->getStorage());
+        // Interned in the same order, the field-indexed labels keep the labels the grammar and baseEdges use
+        std::array<bool, MaxEdgeLabels> bars{};
+        for (EdgeLabel label = NumEdgeLabels; label < graph->getLabelNum(); label += 2)
+            fresh->internLabel(graph->baseOf(label), graph->fieldOf(label));
+        for (EdgeLabel label = 1; label < graph->getLabelNum(); label += 2)
+            bars[label] = graph->isMirrored(label);
+        for (const CFLREdge &edge : baseEdges)
+            fresh->addEdge(edge.src, edge.dst, edge.label);
+        fresh->mirrorBars(bars);
+        delete graph;
+        graph = fresh;
+        queries = QueryCache();
+        solve();
+        return true;
+    }
+
+    // 1. Over-delete: every derived edge with a derivation through a deleted edge, in the graph as it was
+    std::unordered_set<CFLREdge> deleted(removed.begin(), removed.end());
+    std::vector<CFLREdge> stack(removed);
+    auto overDelete = [&](unsigned u, unsigned v, EdgeLabel label) {
+        CFLREdge edge(u, v, label);
+        if (graph->hasEdge(u, v, label) && !baseEdges.count(edge) && deleted.insert(edge).second)
+            stack.push_back(edge);
+    };
+    while (!stack.empty())
+    {
+        CFLREdge edge = stack.back();
+        stack.pop_back();
+        unsigned u = edge.src;
+        unsigned v = edge.dst;
+        for (EdgeLabel head : grammar.unary(edge.label))
+            overDelete(u, v, head);
+        for (const CFLRGrammar::Entry &rule : grammar.asLeft(edge.label))
+            for (unsigned w : graph->successors(v, rule.other))
+                overDelete(u, w, rule.head);
+        for (const CFLRGrammar::Entry &rule : grammar.asRight(edge.label))
+            for (unsigned w : graph->predecessors(u, rule.other))
+                overDelete(w, v, rule.head);
+        EdgeLabel inv = grammar.inverse(edge.label);
+        if (inv != CFLRGrammar::NoLabel)
+            overDelete(v, u, inv);
+    }
+
+    for (const CFLREdge &edge : deleted)
+        graph->removeEdge(edge.src, edge.dst, edge.label);
+
+    // 2. Re-derive: the productions indexed by their head
+    std::array<std::vector<EdgeLabel>, MaxEdgeLabels> unaryBodies;
+    std::array<std::vector<CFLRGrammar::Binary>, MaxEdgeLabels> binaryRules;
+    std::array<std::vector<EdgeLabel>, MaxEdgeLabels> inverseOf;
+    for (EdgeLabel label = 0; label < graph->getLabelNum(); ++label)
+    {
+        for (EdgeLabel head : grammar.unary(label))
+            unaryBodies[head].push_back(label);
+        EdgeLabel inv = grammar.inverse(label);
+        if (inv != CFLRGrammar::NoLabel)
+            inverseOf[inv].push_back(label);
+    }
+    for (const CFLRGrammar::Binary &rule : grammar.binaries())
+        binaryRules[rule.head].push_back(rule);
+
+    auto derivable = [&](const CFLREdge &edge) {
+        unsigned u = edge.src;
+        unsigned v = edge.dst;
+        for (EdgeLabel body : unaryBodies[edge.label])
+            if (graph->hasEdge(u, v, body))
+                return true;
+        for (const CFLRGrammar::Binary &rule : binaryRules[edge.label])
+            for (unsigned w : graph->successors(u, rule.left))
+                if (graph->hasEdge(w, v, rule.right))
+                    return true;
+        for (EdgeLabel label : inverseOf[edge.label])
+            if (graph->hasEdge(v, u, label))
+                return true;
+        return false;
+    };
+
+    // The re-derived edges are queued, so that whatever follows from them is derived again by the fixpoint.
+    // As in the solver, an edge brings its inverse along, which may not have been re-derived before it.
+    for (const CFLREdge &edge : deleted)
+    {
+        if (!derivable(edge) || !graph->insertIfAbsent(edge.src, edge.dst, edge.label))
+            continue;
+        pushEdge(edge);
+        EdgeLabel inv = grammar.inverse(edge.label);
+        if (inv != CFLRGrammar::NoLabel && (graph->insertIfAbsent(edge.dst, edge.src, inv) || graph->isMirrored(inv)))
+            pushEdge(CFLREdge(edge.dst, edge.src, inv));
+    }
+    propagate();
+
+    // Memoised demand-driven results may be stale
+    queries = QueryCache();
+    return true;
+}
+
+
+bool CFLR::applyUpdates(const std::string &fileName)
+{
+    std::ifstream inFile(fileName, std::ios::in);
+    if (!inFile)
+    {
+        std::cout << "error opening " + fileName + "!!\n";
+        return false;
+    }
+
+    std::vector<CFLREdge> batch;
+    char batchKind = '+';
+    auto flush = [&]() {
+        bool ok = batchKind == '+' ? addInitialEdges(batch) : removeInitialEdges(batch);
+        batch.clear();
+        return ok;
+    };
+
+    std::string line;
+    for (unsigned lineNo = 1; std::getline(inFile, line); ++lineNo)
+    {
+        std::istringstream tokens(line);
+        std::string kind, labelName;
+        unsigned src, dst;
+        if (!(tokens >> kind) || kind[0] == '#')
+            continue;
+        EdgeLabel label = CFLRGrammar::NoLabel;
+        if (tokens >> src >> dst >> labelName)
+            label = CFLRGrammar::labelByName(labelName);
+        if ((kind != "+" && kind != "-") || label == CFLRGrammar::NoLabel)
+        {
+            std::cout << fileName << ":" << lineNo << ": malformed update '" << line << "'\n";
+            return false;
+        }
+        if (kind[0] != batchKind)
+        {
+            if (!flush())
+                return false;
+            batchKind = kind[0];
+        }
+        // A statement without its Bar edge would leave the inverse derivations out of the results
+        if (label <= LoadBar)
+        {
+            if (label & 1)
+                std::swap(src, dst);
+            label &= ~1u;
+            batch.push_back(CFLREdge(dst, src, label + 1));
+        }
+        batch.push_back(CFLREdge(src, dst, label));
+    }
+    return flush();
+}
@@ -4,19 +4,38 @@
  */
 
 #include "A4Header.h"
+#include "A4Result.h"
+#include "SVFIRArtifact.h"
 
-CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
+#include <charconv>
+#include <cstring>
+#include <numeric>
+
+const CFLRGraph::NodeSet CFLRGraph::emptySet;
+
+
+CFLRGraph::CFLRGraph(SVF::SVFIR *pag, CFLRStorage storage, unsigned fieldLimit) :
+        storage(storage), numNodes(storage == CFLRStorage::Dense ? pag->getTotalNodeNum() : 0)
 {
+    // All initial edges are collected first and inserted in bulk, see addEdges
+    std::vector<CFLREdge> edges;
+    size_t numStmts = 0;
+    for (SVF::PAGEdge::PEDGEK kind : {SVF::PAGEdge::Addr, SVF::PAGEdge::Copy, SVF::PAGEdge::Phi, SVF::PAGEdge::Select,
+                                      SVF::PAGEdge::Call, SVF::PAGEdge::Ret, SVF::PAGEdge::ThreadFork,
+                                      SVF::PAGEdge::ThreadJoin, SVF::PAGEdge::Store, SVF::PAGEdge::Load})
+        numStmts += pag->getSVFStmtSet(kind).size();
+    edges.reserve(2 * numStmts);
+
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Addr))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Addr);
-        addEdge(edge->getDstID(), edge->getSrcID(), AddrBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Addr);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), AddrBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Copy))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Copy);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Phi))
@@ -24,8 +43,8 @@ CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
         const SVF::PhiStmt *phi = SVF::SVFUtil::cast<SVF::PhiStmt>(edge);
         for (const auto opVar : phi->getOpndVars())
         {
-            addEdge(opVar->getId(), phi->getResID(), Copy);
-            addEdge(phi->getResID(), opVar->getId(), CopyBar);
+            edges.emplace_back(opVar->getId(), phi->getResID(), Copy);
+            edges.emplace_back(phi->getResID(), opVar->getId(), CopyBar);
         }
     }
 
@@ -34,72 +53,497 @@ CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
         const SVF::SelectStmt *sel = SVF::SVFUtil::cast<SVF::SelectStmt>(edge);
         for (const auto opVar : sel->getOpndVars())
         {
-            addEdge(opVar->getId(), sel->getResID(), Copy);
-            addEdge(sel->getResID(), opVar->getId(), CopyBar);
+            edges.emplace_back(opVar->getId(), sel->getResID(), Copy);
+            edges.emplace_back(sel->getResID(), opVar->getId(), CopyBar);
         }
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Call))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Copy);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Ret))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Copy);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::ThreadFork))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Copy);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::ThreadJoin))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Copy);
-        addEdge(edge->getDstID(), edge->getSrcID(), CopyBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Copy);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), CopyBar);
     }
 
     // opt load and store
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Store))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Store);
-        addEdge(edge->getDstID(), edge->getSrcID(), StoreBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Store);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), StoreBar);
     }
     for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Load))
     {
-        addEdge(edge->getSrcID(), edge->getDstID(), Load);
-        addEdge(edge->getDstID(), edge->getSrcID(), LoadBar);
+        edges.emplace_back(edge->getSrcID(), edge->getDstID(), Load);
+        edges.emplace_back(edge->getDstID(), edge->getSrcID(), LoadBar);
+    }
+
+    // Field-sensitive runs keep the field index of Gep statements in their label
+    if (fieldLimit)
+    {
+        for (SVF::PAGEdge *edge : pag->getSVFStmtSet(SVF::PAGEdge::Gep))
+        {
+            const SVF::GepStmt *gep = SVF::SVFUtil::cast<SVF::GepStmt>(edge);
+            EdgeLabel label = gepLabel(gep->isConstantOffset() ? (int64_t) gep->getConstantStructFldIdx() : -1,
+                                       fieldLimit);
+            edges.emplace_back(edge->getSrcID(), edge->getDstID(), label);
+            edges.emplace_back(edge->getDstID(), edge->getSrcID(), label ^ 1);
+        }
+    }
+    addEdges(edges);
+}
+
+
+bool CFLRGraph::insertInto(DenseMap &dense, DataMap &hashed, unsigned int node, EdgeLabel label, unsigned int elem)
+{
+    if (storage == CFLRStorage::Dense)
+        return denseSet(dense, node, label).test_and_set(elem);
+    numNodes = std::max(numNodes, std::max(node, elem) + 1);
+    return hashed[label][node].test_and_set(elem);
+}
+
+
+bool CFLRGraph::removeEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
+{
+    if (mirroredBars[EdgeLabel])
+        return removeEdge(dst, src, EdgeLabel ^ 1);
+    if (!hasEdge(src, dst, EdgeLabel))
+        return false;
+    if (storage == CFLRStorage::Dense)
+    {
+        denseSucc[EdgeLabel][src]->reset(dst);
+        densePred[EdgeLabel][dst]->reset(src);
+        return true;
+    }
+    auto succItr = succMap[EdgeLabel].find(src);
+    succItr->second.reset(dst);
+    if (succItr->second.empty())
+        succMap[EdgeLabel].erase(succItr);
+    auto predItr = predMap[EdgeLabel].find(dst);
+    predItr->second.reset(src);
+    if (predItr->second.empty())
+        predMap[EdgeLabel].erase(predItr);
+    return true;
+}
+
+
+void CFLRGraph::mirrorBars(const std::array<bool, MaxEdgeLabels> &bars)
+{
+    for (EdgeLabel bar = 1; bar < getLabelNum(); bar += 2)
+    {
+        if (!bars[bar] || mirroredBars[bar])
+            continue;
+        EdgeLabel twin = bar ^ 1;
+        std::vector<CFLREdge> reversed;
+        for (unsigned src = 0; src < numNodes; ++src)
+            for (unsigned dst : successors(src, bar))
+                reversed.emplace_back(dst, src, twin);
+        for (const CFLREdge &edge : reversed)
+            insertIfAbsent(edge.src, edge.dst, edge.label);
+
+        DenseMap::value_type(&arena).swap(denseSucc[bar]);
+        DenseMap::value_type(&arena).swap(densePred[bar]);
+        DataMap::value_type(&arena).swap(succMap[bar]);
+        DataMap::value_type(&arena).swap(predMap[bar]);
+        mirroredBars[bar] = true;
+    }
+}
+
+
+void CFLRGraph::mergeInto(unsigned int node, unsigned int rep)
+{
+    assert(node != rep && "cannot merge a node into itself");
+    if (parents.size() < numNodes)
+    {
+        unsigned oldSize = parents.size();
+        parents.resize(numNodes);
+        for (unsigned n = oldSize; n < numNodes; ++n)
+            parents[n] = n;
+    }
+    parents[node] = rep;
+
+    std::vector<unsigned> outs, ins;
+    for (EdgeLabel label = 0; label < getLabelNum(); ++label)
+    {
+        outs.assign(successors(node, label).begin(), successors(node, label).end());
+        ins.assign(predecessors(node, label).begin(), predecessors(node, label).end());
+        for (unsigned dst : outs)
+            removeEdge(node, dst, label);
+        for (unsigned src : ins)
+            removeEdge(src, node, label);
+        // Self loops of the merged node become self loops of the representative
+        for (unsigned dst : outs)
+            insertIfAbsent(rep, dst == node ? rep : dst, label);
+        for (unsigned src : ins)
+            insertIfAbsent(src == node ? rep : src, rep, label);
+    }
+}
+
+
+void CFLRGraph::visitSCCs(EdgeLabel label, const std::vector<unsigned> &roots,
+                          const std::function<void(const std::vector<unsigned> &)> &onSCC) const
+{
+    // Iterative Tarjan over the edges of one label.  A node is on the Tarjan stack while it is visited and
+    // its low link is not Done.
+    const unsigned Unvisited = ~0u;
+    const unsigned Done = ~0u;
+    if (sccIndex.size() < numNodes)
+    {
+        sccIndex.resize(numNodes, Unvisited);
+        sccLowLink.resize(numNodes, 0);
     }
+    std::vector<unsigned> &index = sccIndex;
+    std::vector<unsigned> &lowLink = sccLowLink;
+    std::vector<unsigned> visited;
+    std::vector<unsigned> sccStack;
+    std::vector<unsigned> members;
+    std::vector<std::pair<unsigned, std::vector<unsigned>>> callStack;  // node and its unvisited successors
+    unsigned nextIndex = 0;
+
+    for (unsigned root : roots)
+    {
+        if (index[root] != Unvisited)
+            continue;
+        visited.push_back(root);
+        if (successors(root, label).empty())
+        {
+            index[root] = nextIndex++;
+            lowLink[root] = Done;
+            onSCC({root});
+            continue;
+        }
+
+        auto visit = [&](unsigned n) {
+            index[n] = lowLink[n] = nextIndex++;
+            visited.push_back(n);
+            sccStack.push_back(n);
+            const NodeSet &succs = successors(n, label);
+            callStack.emplace_back(n, std::vector<unsigned>(succs.begin(), succs.end()));
+        };
+        visit(root);
+
+        while (!callStack.empty())
+        {
+            unsigned n = callStack.back().first;
+            std::vector<unsigned> &pending = callStack.back().second;
+            if (!pending.empty())
+            {
+                unsigned m = pending.back();
+                pending.pop_back();
+                if (index[m] == Unvisited)
+                    visit(m);
+                else if (lowLink[m] != Done)
+                    lowLink[n] = std::min(lowLink[n], index[m]);
+                continue;
+            }
+
+            callStack.pop_back();
+            if (!callStack.empty())
+            {
+                unsigned parent = callStack.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[n]);
+            }
+            if (lowLink[n] != index[n])
+                continue;
+
+            members.clear();
+            unsigned m;
+            do
+            {
+                m = sccStack.back();
+                sccStack.pop_back();
+                lowLink[m] = Done;
+                members.push_back(m);
+            } while (m != n);
+            onSCC(members);
+        }
+    }
+
+    for (unsigned n : visited)
+        index[n] = Unvisited;
+}
+
+
+unsigned CFLRGraph::findSCCs(EdgeLabel label, std::vector<unsigned> &sccOf) const
+{
+    std::vector<unsigned> roots(numNodes);
+    std::iota(roots.begin(), roots.end(), 0);
+    sccOf.assign(numNodes, ~0u);
+    unsigned numSCCs = 0;
+    visitSCCs(label, roots, [&](const std::vector<unsigned> &members) {
+        for (unsigned n : members)
+            sccOf[n] = numSCCs;
+        ++numSCCs;
+    });
+    return numSCCs;
 }
 
 
-bool CFLRGraph::hasEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
+unsigned CFLRGraph::collapseCycles(EdgeLabel label, std::vector<unsigned> &changed)
 {
-    return succMap[src][EdgeLabel].count(dst);
+    std::vector<unsigned> roots(numNodes);
+    std::iota(roots.begin(), roots.end(), 0);
+    return collapseCycles(label, roots, changed);
 }
 
 
-void CFLRGraph::addEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
+unsigned CFLRGraph::collapseCycles(EdgeLabel label, const std::vector<unsigned> &roots, std::vector<unsigned> &changed)
 {
-    succMap[src][EdgeLabel].insert(dst);
-    predMap[dst][EdgeLabel].insert(src);
+    // Merged nodes have no edges left: start from their representatives
+    std::vector<unsigned> reps;
+    reps.reserve(roots.size());
+    for (unsigned root : roots)
+        reps.push_back(rep(root));
+
+    // The graph must not change during the traversal, so the components are merged afterwards
+    std::vector<std::vector<unsigned>> cycles;
+    visitSCCs(label, reps, [&](const std::vector<unsigned> &members) {
+        if (members.size() > 1)
+            cycles.push_back(members);
+    });
+
+    // Each component is merged into its smallest node
+    unsigned merged = 0;
+    for (const std::vector<unsigned> &members : cycles)
+    {
+        unsigned sccRep = *std::min_element(members.begin(), members.end());
+        for (unsigned n : members)
+            if (n != sccRep)
+            {
+                mergeInto(n, sccRep);
+                ++merged;
+            }
+        changed.push_back(sccRep);
+    }
+    return merged;
+}
+
+
+CFLRGraph::CFLRGraph(unsigned int numNodes, CFLRStorage storage) :
+        storage(storage), numNodes(numNodes)
+{}
+
+
+namespace
+{
+
+/// LSD radix sort of 64-bit keys, 16 bits per pass.  Passes over a digit shared by all keys are skipped.
+void radixSort(std::vector<uint64_t> &keys)
+{
+    if (keys.empty())
+        return;
+    std::vector<uint64_t> buffer(keys.size());
+    std::vector<size_t> offsets(1 << 16);
+    for (unsigned shift = 0; shift < 64; shift += 16)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint64_t key : keys)
+            ++offsets[(key >> shift) & 0xFFFF];
+        if (offsets[(keys[0] >> shift) & 0xFFFF] == keys.size())
+            continue;
+        size_t sum = 0;
+        for (size_t &offset : offsets)
+        {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (uint64_t key : keys)
+            buffer[offsets[(key >> shift) & 0xFFFF]++] = key;
+        keys.swap(buffer);
+    }
+}
+
+}
+
+
+void CFLRGraph::addEdges(const CFLREdge *edges, size_t numEdges)
+{
+    if (numEdges == 0)
+        return;
+
+    // Keys are (node, label, other node): after sorting, the edges of one set are adjacent and in ascending order,
+    // so every set is appended to at its end and looked up once
+    const unsigned OtherBits = CFLREdge::NodeBits;
+    const uint64_t OtherMask = (1u << OtherBits) - 1;
+    unsigned maxNode = 0;
+    for (size_t i = 0; i < numEdges; ++i)
+    {
+        const CFLREdge &edge = edges[i];
+        assert(edge.src < (1u << CFLREdge::NodeBits) && edge.dst < (1u << CFLREdge::NodeBits) &&
+               edge.label < (1u << CFLREdge::LabelBits) && "edge does not fit into a 64-bit key");
+        maxNode = std::max(maxNode, std::max(edge.src, edge.dst));
+    }
+
+    // Sized once, so that no label array is reallocated while it is filled
+    if (storage == CFLRStorage::Dense)
+        growDense(maxNode);
+    else
+        numNodes = std::max(numNodes, maxNode + 1);
+
+    auto fill = [&](std::vector<uint64_t> &keys, DenseMap &dense, DataMap &hashed) {
+        radixSort(keys);
+        if (storage == CFLRStorage::HashMap)
+        {
+            std::array<size_t, MaxEdgeLabels> groups{};
+            for (size_t i = 0; i < keys.size(); ++i)
+                if (i == 0 || (keys[i] >> OtherBits) != (keys[i - 1] >> OtherBits))
+                    ++groups[(keys[i] >> OtherBits) & ((1u << CFLREdge::LabelBits) - 1)];
+            for (EdgeLabel label = 0; label < getLabelNum(); ++label)
+                hashed[label].reserve(hashed[label].size() + groups[label]);
+        }
+
+        NodeSet *set = nullptr;
+        uint64_t group = ~0ULL;
+        for (uint64_t key : keys)
+        {
+            if ((key >> OtherBits) != group)
+            {
+                group = key >> OtherBits;
+                unsigned node = group >> CFLREdge::LabelBits;
+                EdgeLabel label = group & ((1u << CFLREdge::LabelBits) - 1);
+                set = storage == CFLRStorage::Dense ? &denseSet(dense, node, label) : &hashed[label][node];
+            }
+            set->set(key & OtherMask);
+        }
+    };
+
+    // Mirrored Bar edges are stored as the reversed edges of their twin
+    auto stored = [&](const CFLREdge &edge) {
+        return mirroredBars[edge.label] ? CFLREdge(edge.dst, edge.src, edge.label ^ 1) : edge;
+    };
+
+    std::vector<uint64_t> keys(numEdges);
+    for (size_t i = 0; i < numEdges; ++i)
+    {
+        CFLREdge edge = stored(edges[i]);
+        keys[i] = ((uint64_t) edge.src << (CFLREdge::LabelBits + OtherBits)) |
+                  ((uint64_t) edge.label << OtherBits) | edge.dst;
+    }
+    fill(keys, denseSucc, succMap);
+
+    for (size_t i = 0; i < numEdges; ++i)
+    {
+        CFLREdge edge = stored(edges[i]);
+        keys[i] = ((uint64_t) edge.dst << (CFLREdge::LabelBits + OtherBits)) |
+                  ((uint64_t) edge.label << OtherBits) | edge.src;
+    }
+    fill(keys, densePred, predMap);
+}
+
+
+void CFLRGraph::growDense(unsigned int node)
+{
+    if (node < numNodes)
+        return;
+    numNodes = node + 1;
+    for (EdgeLabel label = 0; label < getLabelNum(); ++label)
+    {
+        // Unused labels stay unallocated
+        if (!denseSucc[label].empty())
+            denseSucc[label].resize(numNodes);
+        if (!densePred[label].empty())
+            densePred[label].resize(numNodes);
+    }
+}
+
+
+void CFLRGraph::allocateDense(const std::array<bool, MaxEdgeLabels> &labels)
+{
+    assert(storage == CFLRStorage::Dense && "only the dense storage can be preallocated");
+    for (EdgeLabel label = 0; label < getLabelNum(); ++label)
+    {
+        if (!labels[label])
+            continue;
+        // A mirrored label is inserted into the arrays of its twin
+        EdgeLabel stored = mirroredBars[label] ? label ^ 1 : label;
+        denseSucc[stored].resize(numNodes);
+        densePred[stored].resize(numNodes);
+    }
+}
+
+
+CFLRGraph::NodeSet &CFLRGraph::denseSet(DenseMap &map, unsigned int node, EdgeLabel label)
+{
+    // Growing reallocates the label arrays, so all node IDs must be known before the graph is traversed
+    growDense(node);
+    auto &sets = map[label];
+    if (sets.empty())
+        sets.resize(numNodes);
+    if (!sets[node])
+        sets[node] = std::make_unique<NodeSet>();
+    return *sets[node];
 }
 
 
 void CFLR::buildGraph(SVF::PAG *pag)
 {
     if (!graph)
-        graph = new CFLRGraph(pag);
+        graph = new CFLRGraph(pag, options.storage, options.fieldLimit);
+    moduleName = pag->getModuleIdentifier();
+}
+
+
+bool CFLR::loadArtifact(const std::string &fileName)
+{
+    SVFIRArtifact artifact;
+    if (!artifact.load(fileName))
+        return false;
+    // load checks the statements against numPAGNodes; the edges hold node ids of NodeBits bits
+    if (artifact.numPAGNodes > (1u << CFLREdge::NodeBits))
+    {
+        std::cout << fileName + ": " + std::to_string(artifact.numPAGNodes) + " PAG nodes are too many!!\n";
+        return false;
+    }
+
+    delete graph;
+    graph = new CFLRGraph(options.storage == CFLRStorage::Dense ? artifact.numPAGNodes : 0, options.storage);
+
+    std::vector<CFLREdge> edges;
+    edges.reserve(2 * artifact.stmts.size());
+    for (auto &stmt : artifact.stmts)
+    {
+        EdgeLabel label;
+        if (stmt.kind == SVFIRArtifact::Gep && options.fieldLimit)
+            label = graph->gepLabel(stmt.field, options.fieldLimit);
+        else if (stmt.kind == SVFIRArtifact::Addr)
+            label = Addr;
+        else if (stmt.kind == SVFIRArtifact::Copy)
+            label = Copy;
+        else if (stmt.kind == SVFIRArtifact::Store)
+            label = Store;
+        else if (stmt.kind == SVFIRArtifact::Load)
+            label = Load;
+        else
+            continue;
+        edges.emplace_back(stmt.src, stmt.dst, label);
+        edges.emplace_back(stmt.dst, stmt.src, label ^ 1);
+    }
+    graph->addEdges(edges);
+    moduleName = artifact.module;
+    return true;
 }
 
 
 void CFLR::dumpResult()
 {
-    std::string fname = SVF::PAG::getPAG()->getModuleIdentifier() + ".res.txt";
+    std::string fname = moduleName + ".res.txt";
     std::ofstream outFile(fname, std::ios::out);
     if (!outFile)
     {
@@ -107,25 +551,126 @@ void CFLR::dumpResult()
         return;
     }
 
-    // Collect S-edges
-    std::map<unsigned, std::set<unsigned >> edgeSet;  // ordered edge set
-    for (auto &nodeItr : graph->getSuccessorMap())
+    // Write S-edges in node order straight from the graph: the points-to set of each node is a bit-vector,
+    // which already iterates in ascending order.  Nodes merged into a representative share its set.
+    // Lines are formatted into a large buffer and written out in blocks instead of being flushed one by one.
+    const size_t BufferSize = 1 << 22;
+    const size_t MaxLine = 64;
+    static const char PointsTo[] = "\tpoints to\t";
+    std::vector<char> buffer(BufferSize);
+    size_t used = 0;
+
+    // The PT_k labels of a field-sensitive run follow PT, by field
+    std::vector<EdgeLabel> ptLabels = {PT};
+    for (unsigned field = 1; field <= options.fieldLimit; ++field)
+        if (graph->findLabel(PT, field) != CFLRGrammar::NoLabel)
+            ptLabels.push_back(graph->findLabel(PT, field));
+
+    for (unsigned src = 0; src < graph->getNodeNum(); ++src)
     {
-        unsigned src = nodeItr.first;
-        for (auto &lblItr : nodeItr.second)
+        char srcText[16];
+        size_t srcLen = std::to_chars(srcText, srcText + sizeof(srcText), src).ptr - srcText;
+        for (EdgeLabel label : ptLabels)
         {
-            if (lblItr.first == PT)
-                for (auto dst : lblItr.second)
-                    edgeSet[src].insert(dst);
+            unsigned field = graph->fieldOf(label);
+            const CFLRGraph::NodeSet &pts = label == PT ? pointsTo(src) : graph->successors(graph->rep(src), label);
+            for (unsigned dst : pts)
+            {
+                if (used + MaxLine > BufferSize)
+                {
+                    outFile.write(buffer.data(), used);
+                    used = 0;
+                }
+                char *out = buffer.data() + used;
+                out = std::copy(srcText, srcText + srcLen, out);
+                out = std::copy(PointsTo, PointsTo + sizeof(PointsTo) - 1, out);
+                out = std::to_chars(out, out + 16, dst).ptr;
+                if (field)
+                {
+                    *out++ = '.';
+                    out = std::to_chars(out, out + 16, field).ptr;
+                }
+                *out++ = '\n';
+                used = out - buffer.data();
+            }
         }
     }
+    outFile.write(buffer.data(), used);
+}
+
 
-    // Write S-edges
-    for (auto &srcItr : edgeSet)
+void CFLR::dumpBinaryResult()
+{
+    std::string fname = moduleName + ".res.bin";
+    std::ofstream outFile(fname, std::ios::out | std::ios::binary);
+    if (!outFile)
     {
-        for (auto dst : srcItr.second)
+        std::cout << "error opening " + fname + "!!\n";
+        return;
+    }
+
+    // Encode the target lists first: the offsets index in front of them depends on their sizes
+    unsigned numNodes = graph->getNodeNum();
+    std::vector<uint64_t> offsets;
+    offsets.reserve(numNodes + 1);
+    std::vector<uint8_t> data;
+    for (unsigned src = 0; src < numNodes; ++src)
+    {
+        offsets.push_back(data.size());
+        unsigned last = 0;
+        bool first = true;
+        for (unsigned dst : pointsTo(src))
         {
-            outFile << srcItr.first << '\t' << "points to" << '\t' << dst << std::endl;
+            appendVarint(data, first ? dst : dst - last);
+            last = dst;
+            first = false;
         }
     }
-}
\ No newline at end of file
+    offsets.push_back(data.size());
+
+    CFLRResultHeader header;
+    std::memcpy(header.magic, CFLRResultMagic, sizeof(header.magic));
+    header.version = CFLRResultVersion;
+    header.numNodes = numNodes;
+    header.dataSize = data.size();
+
+    outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    outFile.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    outFile.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+void CFLR::dumpGraph(const std::string &stage, const CFLRDumpFilter &filter)
+{
+    std::string fname = moduleName + "." + stage + (filter.dot ? ".dot" : ".edges");
+    std::ofstream outFile(fname, std::ios::out);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return;
+    }
+
+    if (filter.dot)
+        outFile << "digraph \"" << stage << "\" {\n";
+    // Field-indexed labels are selected by their base label
+    graph->forEachEdge([&](unsigned src, unsigned dst, EdgeLabel label) {
+        if (!filter.accepts(src, dst, graph->baseOf(label)))
+            return;
+        if (filter.dot)
+            outFile << "  " << src << " -> " << dst << " [label=\"" << graph->labelName(label) << "\"];\n";
+        else
+            outFile << src << ' ' << dst << ' ' << graph->labelName(label) << '\n';
+    });
+    // The shared-set solver keeps the PT edges it derives out of the graph
+    for (unsigned src = 0; !ptOf.empty() && src < ptOf.size(); ++src)
+        for (unsigned dst : ptSets.get(ptOf[src]))
+        {
+            if (!filter.accepts(src, dst, PT))
+                continue;
+            if (filter.dot)
+                outFile << "  " << src << " -> " << dst << " [label=\"PT\"];\n";
+            else
+                outFile << src << ' ' << dst << " PT\n";
+        }
+    if (filter.dot)
+        outFile << "}\n";
+}
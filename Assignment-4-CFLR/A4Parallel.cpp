@@ -0,0 +1,182 @@
+/**
+ * A4Parallel.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+
+/// The deque of one thread.  The owner pops from the back; other threads steal from the front.
+/// The deque is only touched under the mutex, so its own unsynchronised pool suffices.
+struct Shard
+{
+    std::mutex mutex;
+    std::pmr::unsynchronized_pool_resource pool;
+    std::pmr::deque<CFLREdge> edges{&pool};
+};
+
+constexpr unsigned NumStripes = 4096;
+
+}
+
+void CFLR::solveParallel()
+{
+    unsigned numThreads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+
+    // No label array may be reallocated once the threads are running.  Only the derived labels and their
+    // inverses are inserted into; the labels of the initial edges are allocated already.
+    std::array<bool, MaxEdgeLabels> inserted = derivedLabels();
+    for (EdgeLabel label = 0; label < graph->getLabelNum(); ++label)
+        if (inserted[label] && grammar.inverse(label) != CFLRGrammar::NoLabel)
+            inserted[grammar.inverse(label)] = true;
+    graph->allocateDense(inserted);
+
+    // The successors and predecessors of a node are guarded by the same stripe.
+    // This way, for two edges (u, v) and (v, w) inserted concurrently, the one processed last sees the other one.
+    std::vector<std::mutex> stripes(NumStripes);
+    std::vector<Shard> shards(numThreads);
+    std::atomic<size_t> pending(0);     // edges pushed but not yet fully processed
+
+    auto stripe = [&](unsigned node) -> std::mutex & { return stripes[node % NumStripes]; };
+
+    // Every thread counts on its own, the counters are merged once the threads are done
+    std::vector<CFLRCounters> counters(numThreads);
+
+    auto push = [&](const CFLREdge &edge, CFLRCounters &c) {
+        Shard &shard = shards[edge.src % numThreads];
+        size_t waiting = pending.fetch_add(1, std::memory_order_relaxed) + 1;
+        ++c.pushes;
+        c.maxWorkList = std::max<uint64_t>(c.maxWorkList, waiting);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        shard.edges.push_back(edge);
+    };
+
+    // Inserts the successor under the stripe of u, then the predecessor under the stripe of v.
+    // The edge is only pushed once both directions are visible.
+    auto insert = [&](unsigned u, unsigned v, EdgeLabel label) {
+        {
+            std::lock_guard<std::mutex> guard(stripe(u));
+            if (!graph->insertSuccessor(u, v, label))
+                return false;
+        }
+        std::lock_guard<std::mutex> guard(stripe(v));
+        graph->insertPredecessor(u, v, label);
+        return true;
+    };
+
+    auto addEdge = [&](unsigned u, unsigned v, EdgeLabel label, CFLRCounters &c) {
+        if (!insert(u, v, label))
+        {
+            ++c.duplicates;
+            return;
+        }
+        push(CFLREdge(u, v, label), c);
+        ++c.derived[label];
+        EdgeLabel inv = grammar.inverse(label);
+        if (inv != CFLRGrammar::NoLabel && (insert(v, u, inv) || graph->isMirrored(inv)))
+        {
+            push(CFLREdge(v, u, inv), c);
+            ++c.derived[inv];
+        }
+    };
+
+    // Copies the neighbours out under the stripe lock, so that no set is read (or allocated) while another
+    // thread writes it
+    auto collect = [&](unsigned node, EdgeLabel label, bool succ, std::vector<unsigned> &out) {
+        out.clear();
+        std::lock_guard<std::mutex> guard(stripe(node));
+        for (unsigned n : succ ? graph->successors(node, label) : graph->predecessors(node, label))
+            out.push_back(n);
+    };
+
+    auto process = [&](const CFLREdge &edge, std::vector<unsigned> &buf, CFLRCounters &c) {
+        unsigned u = edge.src;
+        unsigned v = edge.dst;
+        EdgeLabel lbl = edge.label;
+
+        // Unary rules: (u --lbl--> v)  ==>  (u --head--> v)
+        for (EdgeLabel head : grammar.unary(lbl))
+            addEdge(u, v, head, c);
+
+        // Right matching: (u --lbl--> v) * (v --other--> w)
+        for (const CFLRGrammar::Entry &rule : grammar.asLeft(lbl))
+        {
+            collect(v, rule.other, true, buf);
+            for (unsigned w : buf)
+                addEdge(u, w, rule.head, c);
+        }
+
+        // Left matching: (w --other--> u) * (u --lbl--> v)
+        for (const CFLRGrammar::Entry &rule : grammar.asRight(lbl))
+        {
+            collect(u, rule.other, false, buf);
+            for (unsigned w : buf)
+                addEdge(w, v, rule.head, c);
+        }
+    };
+
+    auto take = [&](unsigned self, CFLREdge &edge) {
+        {
+            Shard &own = shards[self];
+            std::lock_guard<std::mutex> guard(own.mutex);
+            if (!own.edges.empty())
+            {
+                edge = own.edges.back();
+                own.edges.pop_back();
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < numThreads; ++i)
+        {
+            Shard &victim = shards[(self + i) % numThreads];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if (!victim.edges.empty())
+            {
+                edge = victim.edges.front();
+                victim.edges.pop_front();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto worker = [&](unsigned self) {
+        std::vector<unsigned> buf;
+        CFLREdge edge(0, 0, 0);
+        while (true)
+        {
+            if (take(self, edge))
+            {
+                ++counters[self].pops;
+                process(edge, buf, counters[self]);
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            else if (pending.load(std::memory_order_acquire) == 0)
+                break;
+            else
+                std::this_thread::yield();
+        }
+    };
+
+    graph->forEachEdge([&](unsigned u, unsigned v, EdgeLabel lbl) {
+        push(CFLREdge(u, v, lbl), counters[0]);
+    });
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (std::thread &t : threads)
+        t.join();
+
+    for (const CFLRCounters &c : counters)
+        stats.counters += c;
+}
@@ -0,0 +1,132 @@
+/**
+ * A4Query.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+/*
+ * The points-to grammar, restated over the demanded nodes only:
+ *   pt(p)       = { o | o --Addr--> p }  U  pt(v) for v --Copy--> p
+ *                 U  pt(x) for u --Load--> p, o in pt(u), v in flowsTo(o), x --Store--> v
+ *   flowsTo(o)  = { p | o in pt(p) }, computed forwards from the Addr edges of o
+ * Every fact is propagated once along the subscriptions recorded in QueryCache, like a worklist
+ * Andersen solver, so a query costs no more than the part of the program it depends on.
+ */
+bool CFLR::queryPointsTo(unsigned node, CFLRGraph::NodeSet &pts)
+{
+    using Event = QueryCache::Event;
+    QueryCache &q = queries;
+    // After collapseCycles, the edges of a merged node are those of its representative
+    node = graph->rep(node);
+
+    auto demandPointer = [&](unsigned p) {
+        if (q.demandedPointers.test_and_set(p))
+            q.events.push_back({QueryCache::DemandPointer, p, 0});
+    };
+    auto demandObject = [&](unsigned o) {
+        if (q.demandedObjects.test_and_set(o))
+            q.events.push_back({QueryCache::DemandObject, o, 0});
+    };
+    auto addPointsTo = [&](unsigned p, unsigned o) {
+        if (q.pointsTo[p].test_and_set(o))
+            q.events.push_back({QueryCache::NewPointsTo, p, o});
+    };
+    auto addFlowsTo = [&](unsigned o, unsigned p) {
+        if (q.flowsTo[o].test_and_set(p))
+            q.events.push_back({QueryCache::NewFlowsTo, o, p});
+    };
+
+    // pt(to) includes pt(from)
+    auto addCopy = [&](unsigned from, unsigned to) {
+        demandPointer(from);
+        if (q.copiesTo[from].test_and_set(to))
+            for (unsigned o : q.pointsTo[from])
+                addPointsTo(to, o);
+    };
+    // p loads from o: the points-to sets of the pointers stored into o flow into p
+    auto addLoadFrom = [&](unsigned o, unsigned p) {
+        demandObject(o);
+        if (q.loadsFrom[o].test_and_set(p))
+            for (unsigned v : q.flowsTo[o])
+                for (unsigned x : graph->predecessors(v, Store))
+                    addCopy(x, p);
+    };
+    // A pointer flowing to obj is stored into o2: whatever loads from o2 receives obj as well
+    auto addStoreInto = [&](unsigned o2, unsigned obj) {
+        demandObject(o2);
+        if (q.storedInto[o2].test_and_set(obj))
+            for (unsigned u : q.flowsTo[o2])
+                for (unsigned n : graph->successors(u, Load))
+                    addFlowsTo(obj, n);
+    };
+    // A pointer flowing to obj is stored into *v
+    auto addStoreTo = [&](unsigned v, unsigned obj) {
+        demandPointer(v);
+        if (q.storesTo[v].test_and_set(obj))
+            for (unsigned o2 : q.pointsTo[v])
+                addStoreInto(o2, obj);
+    };
+
+    demandPointer(node);
+
+    // Facts left over by an earlier query that ran out of budget are propagated here as well
+    unsigned steps = 0;
+    while (!q.events.empty())
+    {
+        if (++steps > options.queryBudget)
+        {
+            pts = q.pointsTo[node];
+            return false;
+        }
+        Event e = q.events.front();
+        q.events.pop_front();
+
+        switch (e.kind)
+        {
+        case QueryCache::DemandPointer:
+            for (unsigned o : graph->successors(e.node, AddrBar))
+                addPointsTo(e.node, o);
+            for (unsigned v : graph->predecessors(e.node, Copy))
+                addCopy(v, e.node);
+            for (unsigned u : graph->predecessors(e.node, Load))
+            {
+                demandPointer(u);
+                if (q.loadsTo[u].test_and_set(e.node))
+                    for (unsigned o : q.pointsTo[u])
+                        addLoadFrom(o, e.node);
+            }
+            break;
+
+        case QueryCache::DemandObject:
+            for (unsigned p : graph->successors(e.node, Addr))
+                addFlowsTo(e.node, p);
+            break;
+
+        case QueryCache::NewPointsTo:
+            for (unsigned to : q.copiesTo[e.node])
+                addPointsTo(to, e.elem);
+            for (unsigned to : q.loadsTo[e.node])
+                addLoadFrom(e.elem, to);
+            for (unsigned obj : q.storesTo[e.node])
+                addStoreInto(e.elem, obj);
+            break;
+
+        case QueryCache::NewFlowsTo:
+            for (unsigned n : graph->successors(e.elem, Copy))
+                addFlowsTo(e.node, n);
+            for (unsigned v : graph->successors(e.elem, Store))
+                addStoreTo(v, e.node);
+            for (unsigned to : q.loadsFrom[e.node])
+                for (unsigned x : graph->predecessors(e.elem, Store))
+                    addCopy(x, to);
+            for (unsigned obj : q.storedInto[e.node])
+                for (unsigned n : graph->successors(e.elem, Load))
+                    addFlowsTo(obj, n);
+            break;
+        }
+    }
+
+    pts = q.pointsTo[node];
+    return true;
+}
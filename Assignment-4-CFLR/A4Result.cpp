@@ -0,0 +1,104 @@
+/**
+ * A4Result.cpp
+ * @author kisslune
+ */
+
+#include "A4Result.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool CFLRResultReader::open(const std::string &fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CFLRResultHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    mapping = addr;
+    mappingSize = st.st_size;
+    header = static_cast<const CFLRResultHeader *>(addr);
+    // The sizes are checked against what is left of the file, so that no sum can wrap
+    uint64_t rest = mappingSize - sizeof(CFLRResultHeader);
+    uint64_t offsetsSize = (header->numNodes + 1ULL) * sizeof(uint64_t);
+    if (std::memcmp(header->magic, CFLRResultMagic, sizeof(CFLRResultMagic)) != 0 ||
+        header->version != CFLRResultVersion || offsetsSize > rest || header->dataSize != rest - offsetsSize)
+    {
+        close();
+        return false;
+    }
+    offsets = reinterpret_cast<const uint64_t *>(header + 1);
+    data = reinterpret_cast<const uint8_t *>(offsets + header->numNodes + 1);
+
+    // Every target list lies in the data section, after the one before
+    bool ordered = offsets[0] == 0 && offsets[header->numNodes] == header->dataSize;
+    for (uint32_t node = 0; node < header->numNodes && ordered; ++node)
+        ordered = offsets[node] <= offsets[node + 1];
+    if (!ordered)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void CFLRResultReader::close()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    offsets = nullptr;
+    data = nullptr;
+}
+
+
+CFLRResultReader::Cursor CFLRResultReader::cursor(uint32_t node) const
+{
+    if (node >= getNodeNum())
+        return Cursor(nullptr, nullptr);
+    return Cursor(data + offsets[node], data + offsets[node + 1]);
+}
+
+
+std::vector<uint32_t> CFLRResultReader::pointsTo(uint32_t node) const
+{
+    std::vector<uint32_t> targets;
+    Cursor c = cursor(node);
+    for (uint32_t t; c.next(t);)
+        targets.push_back(t);
+    return targets;
+}
+
+
+bool CFLRResultReader::mayAlias(uint32_t a, uint32_t b) const
+{
+    // Both lists are ascending: merge them until a common target shows up
+    Cursor ca = cursor(a), cb = cursor(b);
+    uint32_t ta, tb;
+    if (!ca.next(ta) || !cb.next(tb))
+        return false;
+    while (true)
+    {
+        if (ta == tb)
+            return true;
+        if (ta < tb ? !ca.next(ta) : !cb.next(tb))
+            return false;
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * A4Result.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_A4RESULT_H
+#define ANSWERS_A4RESULT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Binary points-to results (<module>.res.bin), in CSR form:
+ *   CFLRResultHeader
+ *   uint64_t offsets[numNodes + 1]     byte offsets of each node's target list in the data section
+ *   uint8_t data[dataSize]             per node: ascending targets, first as is, then as deltas, all LEB128 varints
+ * Integers are in host byte order, so that the reader can use the mapped offsets in place.  A file written on a
+ * host of the other byte order has a byte-swapped version and is rejected by CFLRResultReader::open.
+ */
+struct CFLRResultHeader
+{
+    char magic[8];          ///< "CFLRPTS\0"
+    uint32_t version;
+    uint32_t numNodes;
+    uint64_t dataSize;
+};
+
+constexpr char CFLRResultMagic[8] = {'C', 'F', 'L', 'R', 'P', 'T', 'S', '\0'};
+constexpr uint32_t CFLRResultVersion = 1;
+
+/// Append an LEB128 varint to out
+inline void appendVarint(std::vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+
+/**
+ * Read-only view on a binary result file.
+ * The file is memory-mapped and only the target lists that are asked for are decoded.
+ */
+class CFLRResultReader
+{
+public:
+    CFLRResultReader() = default;
+    CFLRResultReader(const CFLRResultReader &) = delete;
+    CFLRResultReader &operator=(const CFLRResultReader &) = delete;
+
+    ~CFLRResultReader()
+    { close(); }
+
+    /// Map a result file, return false if it cannot be read, is not a result file, or its offsets are out of order
+    bool open(const std::string &fileName);
+    /// Unmap the file
+    void close();
+
+    /// The number of nodes in the file; nodes beyond have empty points-to sets
+    inline uint32_t getNodeNum() const
+    { return header ? header->numNodes : 0; }
+
+    /// The points-to set of a node, in ascending order
+    std::vector<uint32_t> pointsTo(uint32_t node) const;
+
+    /// Whether the points-to sets of a and b intersect
+    bool mayAlias(uint32_t a, uint32_t b) const;
+
+protected:
+    /// Decodes the target list of one node
+    class Cursor
+    {
+    public:
+        Cursor(const uint8_t *pos, const uint8_t *end) : pos(pos), end(end)
+        {}
+
+        /// Read the next target, return false at the end of the list
+        inline bool next(uint32_t &target)
+        {
+            uint32_t value = 0;
+            for (unsigned shift = 0;; shift += 7)
+            {
+                // A target takes at most 5 bytes; a longer or unterminated varint ends the list
+                if (pos == end || shift >= 32)
+                {
+                    pos = end;
+                    return false;
+                }
+                uint8_t byte = *pos++;
+                value |= (uint32_t) (byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    break;
+            }
+            last = started ? last + value : value;
+            started = true;
+            target = last;
+            return true;
+        }
+
+    private:
+        const uint8_t *pos;
+        const uint8_t *end;
+        uint32_t last = 0;
+        bool started = false;
+    };
+
+    Cursor cursor(uint32_t node) const;
+
+    const CFLRResultHeader *header = nullptr;
+    const uint64_t *offsets = nullptr;
+    const uint8_t *data = nullptr;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+#endif //ANSWERS_A4RESULT_H
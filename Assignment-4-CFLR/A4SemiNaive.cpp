@@ -0,0 +1,102 @@
+/**
+ * A4SemiNaive.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+/// Edges derived in one round, kept as label -> source -> targets like the hash storage of CFLRGraph
+using EdgeDelta = CFLRGraph::DataMap;
+
+void CFLR::solveSemiNaive()
+{
+    // The edges of the previous round (delta) and the ones derived in the current round.
+    // Everything in the graph that is not in delta is "old" and has already been joined with everything else.
+    EdgeDelta delta;
+    EdgeDelta next;
+    CFLRCounters &counters = stats.counters;
+
+    // Adds a new edge to the graph and to the next delta, together with the inverse edges required by the grammar
+    auto addEdge = [&](unsigned u, unsigned v, EdgeLabel label) {
+        if (!graph->insertIfAbsent(u, v, label))
+        {
+            ++counters.duplicates;
+            return;
+        }
+        next[label][u].set(v);
+        ++counters.derived[label];
+        EdgeLabel inv = grammar.inverse(label);
+        if (inv != CFLRGrammar::NoLabel && (graph->insertIfAbsent(v, u, inv) || graph->isMirrored(inv)))
+        {
+            next[inv][v].set(u);
+            ++counters.derived[inv];
+        }
+    };
+
+    auto inDelta = [&](unsigned u, unsigned v, EdgeLabel label) {
+        auto it = delta[label].find(u);
+        return it != delta[label].end() && it->second.test(v);
+    };
+
+    // Rule A -> B C, split into delta(B) * full(C) and old(B) * delta(C)
+    auto join = [&](EdgeLabel a, EdgeLabel b, EdgeLabel c) {
+        for (const auto &srcItr : delta[b])
+        {
+            unsigned u = srcItr.first;
+            for (unsigned v : srcItr.second)
+                for (unsigned w : graph->successors(v, c))
+                    addEdge(u, w, a);
+        }
+        for (const auto &srcItr : delta[c])
+        {
+            unsigned v = srcItr.first;
+            for (unsigned w : srcItr.second)
+                for (unsigned u : graph->predecessors(v, b))
+                    if (!inDelta(u, v, b))
+                        addEdge(u, w, a);
+        }
+    };
+
+    // The initial edges form the first delta
+    graph->forEachEdge([&](unsigned u, unsigned v, EdgeLabel lbl) {
+        delta[lbl][u].set(v);
+    });
+
+    auto empty = [](const EdgeDelta &d) {
+        for (const auto &lblMap : d)
+            if (!lblMap.empty())
+                return false;
+        return true;
+    };
+
+    // A round takes the whole delta off the "worklist"
+    auto size = [](const EdgeDelta &d) {
+        uint64_t edges = 0;
+        for (const auto &lblMap : d)
+            for (const auto &srcItr : lblMap)
+                edges += srcItr.second.count();
+        return edges;
+    };
+
+    while (!empty(delta))
+    {
+        uint64_t roundEdges = size(delta);
+        counters.pushes += roundEdges;
+        counters.pops += roundEdges;
+        counters.maxWorkList = std::max(counters.maxWorkList, roundEdges);
+
+        // Unary rules A -> B, e.g. AddrBar -> PT
+        for (EdgeLabel b = 0; b < graph->getLabelNum(); ++b)
+            for (EdgeLabel head : grammar.unary(b))
+                for (const auto &srcItr : delta[b])
+                    for (unsigned v : srcItr.second)
+                        addEdge(srcItr.first, v, head);
+
+        for (const CFLRGrammar::Binary &rule : grammar.binaries())
+            join(rule.head, rule.left, rule.right);
+
+        std::swap(delta, next);
+        for (auto &lblMap : next)
+            lblMap.clear();
+    }
+}
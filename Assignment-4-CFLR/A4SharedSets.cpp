@@ -0,0 +1,190 @@
+/**
+ * A4SharedSets.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+PointsToSets::PointsToSets()
+{
+    intern(NodeSet());
+}
+
+
+uint64_t PointsToSets::hash(const NodeSet &set)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned elem : set)
+        h = (h ^ elem) * 0x100000001B3ULL;
+    return h;
+}
+
+
+unsigned PointsToSets::intern(const NodeSet &set)
+{
+    std::vector<unsigned> &bucket = byHash[hash(set)];
+    for (unsigned id : bucket)
+        if (sets[id] == set)
+            return id;
+    sets.push_back(set);
+    refs.push_back(0);
+    freed.push_back(false);
+    ++numLive;
+    bucket.push_back(sets.size() - 1);
+    return sets.size() - 1;
+}
+
+
+void PointsToSets::release(unsigned id)
+{
+    if (id == Empty)
+        return;
+    assert(refs[id] > 0 && "set released more often than retained");
+    if (--refs[id] > 0)
+        return;
+    std::vector<unsigned> &bucket = byHash[hash(sets[id])];
+    bucket.erase(std::find(bucket.begin(), bucket.end(), id));
+    sets[id].clear();
+    freed[id] = true;
+    --numLive;
+}
+
+
+unsigned PointsToSets::unite(unsigned a, unsigned b, CFLRCounters &counters)
+{
+    if (a == b || b == Empty)
+        return a;
+    if (a == Empty)
+        return b;
+    ++counters.unions;
+    uint64_t key = (uint64_t) std::min(a, b) << 32 | std::max(a, b);
+    auto cached = unionCache.find(key);
+    if (cached != unionCache.end() && !freed[cached->second])
+    {
+        ++counters.unionHits;
+        return cached->second;
+    }
+    NodeSet result = sets[a];
+    unsigned id = (result |= sets[b]) ? intern(result) : a;
+    if (unionCache.size() >= MaxCachedUnions)
+        unionCache.clear();
+    unionCache[key] = id;
+    return id;
+}
+
+
+const CFLRGraph::NodeSet &CFLR::pointsTo(unsigned node) const
+{
+    unsigned rep = graph->rep(node);
+    if (ptOf.empty())
+        return graph->successors(rep, PT);
+    return ptSets.get(rep < ptOf.size() ? ptOf[rep] : PointsToSets::Empty);
+}
+
+
+void CFLR::solveSharedSets()
+{
+    // Andersen's inclusion constraints, which derive the same PT edges as the points-to grammar:
+    // AddrBar seeds the sets, CopyBar * PT becomes one union per Copy edge, and an object in the sets of both
+    // the pointer of a store x --Store--> p and of a load q --Load--> y makes the set of x flow into y, here
+    // through the memory of the object.  Slots below numNodes are pointers, the others object memories.
+    unsigned numNodes = graph->getNodeNum();
+    CFLRCounters &counters = stats.counters;
+    ptSets = PointsToSets();
+    std::vector<unsigned> setOf(2 * numNodes, PointsToSets::Empty);
+    std::vector<unsigned> handled(numNodes, PointsToSets::Empty);   // objects whose loads and stores are wired
+    std::vector<std::vector<unsigned>> storedInto(numNodes);    // pointer -> objects it is stored into
+    std::vector<std::vector<unsigned>> loadedBy(numNodes);      // object -> pointers loading from it
+    std::unordered_set<uint64_t> wired;     // (pointer, object) of storedInto and (object, pointer) of loadedBy
+
+    std::deque<unsigned> queue;
+    std::vector<bool> queued(2 * numNodes, false);
+    auto push = [&](unsigned slot) {
+        if (queued[slot])
+            return;
+        queued[slot] = true;
+        queue.push_back(slot);
+        ++counters.pushes;
+        counters.maxWorkList = std::max<uint64_t>(counters.maxWorkList, queue.size());
+    };
+    // Slots retain their sets, so that the sets they have outgrown are freed
+    auto assign = [&](unsigned &holder, unsigned set) {
+        ptSets.retain(set);
+        ptSets.release(holder);
+        holder = set;
+    };
+    auto flow = [&](unsigned slot, unsigned set) {
+        unsigned joined = ptSets.unite(setOf[slot], set, counters);
+        if (joined == setOf[slot])
+            return;
+        assign(setOf[slot], joined);
+        push(slot);
+    };
+
+    for (unsigned p = 0; p < numNodes; ++p)
+    {
+        const CFLRGraph::NodeSet &objects = graph->successors(p, AddrBar);
+        if (objects.empty())
+            continue;
+        assign(setOf[p], ptSets.intern(objects));
+        push(p);
+    }
+
+    while (!queue.empty())
+    {
+        unsigned slot = queue.front();
+        queue.pop_front();
+        queued[slot] = false;
+        ++counters.pops;
+
+        if (slot >= numNodes)
+        {
+            unsigned o = slot - numNodes;
+            for (unsigned y : loadedBy[o])
+                flow(y, setOf[slot]);
+            continue;
+        }
+
+        // A Copy self loop may replace the set of v while it is read
+        unsigned v = slot;
+        unsigned set = setOf[v];
+        ptSets.retain(set);
+        for (unsigned u : graph->successors(v, Copy))
+            flow(u, set);
+        for (unsigned o : storedInto[v])
+            flow(numNodes + o, set);
+
+        // Wire the stores through and the loads from v to the objects v points to since its last visit
+        CFLRGraph::NodeSet fresh = ptSets.get(set);
+        fresh.intersectWithComplement(ptSets.get(handled[v]));
+        assign(handled[v], set);
+        ptSets.release(set);
+        for (unsigned o : fresh)
+        {
+            for (unsigned x : graph->predecessors(v, Store))
+            {
+                if (!wired.insert((uint64_t) x << 32 | o).second)
+                    continue;
+                storedInto[x].push_back(o);
+                flow(numNodes + o, setOf[x]);
+            }
+            for (unsigned y : graph->successors(v, Load))
+            {
+                if (!wired.insert((uint64_t) (numNodes + o) << 32 | y).second)
+                    continue;
+                loadedBy[o].push_back(y);
+                flow(y, setOf[numNodes + o]);
+            }
+        }
+    }
+
+    // Only the sets of the pointers stay
+    for (unsigned slot = numNodes; slot < 2 * numNodes; ++slot)
+        ptSets.release(setOf[slot]);
+    for (unsigned &set : handled)
+        ptSets.release(set);
+    setOf.resize(numNodes);
+    ptOf.swap(setOf);
+    for (unsigned p = 0; p < numNodes; ++p)
+        counters.derived[PT] += ptSets.get(ptOf[p]).count();
+}
@@ -0,0 +1,181 @@
+/**
+ * A4Snapshot.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+/*
+ * Snapshot files hold the initial labelled edges of a CFLRGraph:
+ *   SnapshotHeader
+ *   char moduleName[nameSize], zero-padded to a multiple of 4
+ *   uint32_t fieldLabels[numFieldLabels]   packed (base, field) of the even field-indexed labels, in label order
+ *   CFLREdge edges[numEdges]            read in place from the mapped file
+ */
+namespace
+{
+
+constexpr char SnapshotMagic[8] = {'C', 'F', 'L', 'R', 'S', 'N', 'P', '\0'};
+constexpr uint32_t SnapshotVersion = 2;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numNodes;
+    uint64_t key;
+    uint64_t numEdges;
+    uint32_t nameSize;
+    uint32_t numFieldLabels;
+};
+
+static_assert(sizeof(CFLREdge) == 3 * sizeof(uint32_t) && std::is_trivially_copyable<CFLREdge>::value,
+              "snapshot edges are CFLREdges as laid out in memory");
+
+inline uint64_t paddedNameSize(uint32_t nameSize)
+{ return ((uint64_t) nameSize + 3) & ~3ULL; }
+
+/// 64-bit FNV-1a
+inline void hashBytes(uint64_t &hash, const char *bytes, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char) bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+}
+
+}
+
+
+uint64_t CFLR::snapshotKey(const std::vector<std::string> &modules, int argc, char **argv)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (const std::string &module : modules)
+    {
+        std::ifstream inFile(module, std::ios::in | std::ios::binary);
+        char chunk[1 << 16];
+        while (inFile.read(chunk, sizeof(chunk)) || inFile.gcount() > 0)
+            hashBytes(hash, chunk, inFile.gcount());
+        hashBytes(hash, module.c_str(), module.size() + 1);
+    }
+
+    // Solver options do not change the graph, unlike the field limit
+    for (int i = 1; i < argc; ++i)
+        if (argv[i][0] == '-' && (std::strncmp(argv[i], "-cflr-", 6) != 0 || std::strncmp(argv[i], "-cflr-field", 11) == 0))
+            hashBytes(hash, argv[i], std::strlen(argv[i]) + 1);
+
+    return hash;
+}
+
+
+bool CFLR::saveSnapshot(const std::string &fileName, uint64_t key)
+{
+    // Written aside and renamed into place, so that a run sharing the cache never maps a half-written file
+    std::string tempName = fileName + ".tmp" + std::to_string(getpid());
+    std::ofstream outFile(tempName, std::ios::out | std::ios::binary);
+    if (!outFile)
+    {
+        std::cout << "error opening " + tempName + "!!\n";
+        return false;
+    }
+
+    std::vector<CFLREdge> edges;
+    graph->forEachEdge([&](unsigned src, unsigned dst, EdgeLabel label) {
+        edges.emplace_back(src, dst, label);
+    });
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+    header.version = SnapshotVersion;
+    header.numNodes = graph->getNodeNum();
+    header.key = key;
+    header.numEdges = edges.size();
+    header.nameSize = moduleName.size();
+
+    std::vector<uint32_t> fieldLabels;
+    for (EdgeLabel label = NumEdgeLabels; label < graph->getLabelNum(); label += 2)
+        fieldLabels.push_back(CFLRGraph::packLabel(graph->baseOf(label), graph->fieldOf(label)));
+    header.numFieldLabels = fieldLabels.size();
+
+    std::string name = moduleName;
+    name.resize(paddedNameSize(header.nameSize), '\0');
+    outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    outFile.write(name.data(), name.size());
+    outFile.write(reinterpret_cast<const char *>(fieldLabels.data()), fieldLabels.size() * sizeof(uint32_t));
+    outFile.write(reinterpret_cast<const char *>(edges.data()), edges.size() * sizeof(CFLREdge));
+    outFile.close();
+    if (!outFile || std::rename(tempName.c_str(), fileName.c_str()) != 0)
+    {
+        std::cout << "error writing " + fileName + "!!\n";
+        std::remove(tempName.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool CFLR::loadSnapshot(const std::string &fileName, uint64_t key)
+{
+    if (graph)
+        return false;
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(SnapshotHeader))
+        addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    const SnapshotHeader *header = static_cast<const SnapshotHeader *>(addr);
+    const char *name = reinterpret_cast<const char *>(header + 1);
+    // Each section is checked against what is left of the file, so that no size can wrap
+    uint64_t rest = st.st_size - sizeof(SnapshotHeader);
+    uint64_t nameBytes = paddedNameSize(header->nameSize);
+    uint64_t labelBytes = (uint64_t) header->numFieldLabels * sizeof(uint32_t);
+    bool sized = nameBytes <= rest && labelBytes <= rest - nameBytes &&
+                 header->numEdges == (rest - nameBytes - labelBytes) / sizeof(CFLREdge) &&
+                 (rest - nameBytes - labelBytes) % sizeof(CFLREdge) == 0;
+    bool valid = std::memcmp(header->magic, SnapshotMagic, sizeof(SnapshotMagic)) == 0 &&
+                 header->version == SnapshotVersion && header->key == key && sized &&
+                 NumEdgeLabels + 2 * (uint64_t) header->numFieldLabels <= MaxEdgeLabels &&
+                 header->numNodes <= (1u << CFLREdge::NodeBits);
+
+    const uint32_t *fieldLabels = reinterpret_cast<const uint32_t *>(name + (valid ? nameBytes : 0));
+    const uint32_t LabelMask = (1u << CFLREdge::LabelBits) - 1;
+    for (uint32_t i = 0; valid && i < header->numFieldLabels; ++i)
+        valid = (fieldLabels[i] & LabelMask) < NumEdgeLabels && (fieldLabels[i] & 1) == 0 &&
+                (fieldLabels[i] >> CFLREdge::LabelBits) != 0;
+
+    const CFLREdge *edges = reinterpret_cast<const CFLREdge *>(fieldLabels + (valid ? header->numFieldLabels : 0));
+    const unsigned numLabels = NumEdgeLabels + 2 * header->numFieldLabels;
+    for (uint64_t i = 0; valid && i < header->numEdges; ++i)
+        valid = edges[i].src < header->numNodes && edges[i].dst < header->numNodes && edges[i].label < numLabels;
+
+    if (valid)
+    {
+        graph = new CFLRGraph(header->numNodes, options.storage);
+        // Interned in the same order, the field-indexed labels get the labels they were saved with
+        for (uint32_t i = 0; i < header->numFieldLabels; ++i)
+            graph->internLabel(fieldLabels[i] & LabelMask, fieldLabels[i] >> CFLREdge::LabelBits);
+        graph->addEdges(edges, header->numEdges);
+        moduleName.assign(name, header->nameSize);
+    }
+
+    munmap(addr, st.st_size);
+    return valid;
+}
@@ -0,0 +1,70 @@
+/**
+ * A4Stats.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <sys/resource.h>
+
+CFLRCounters &CFLRCounters::operator+=(const CFLRCounters &other)
+{
+    pushes += other.pushes;
+    pops += other.pops;
+    duplicates += other.duplicates;
+    maxWorkList = std::max(maxWorkList, other.maxWorkList);
+    unions += other.unions;
+    unionHits += other.unionHits;
+    for (EdgeLabel label = 0; label < MaxEdgeLabels; ++label)
+        derived[label] += other.derived[label];
+    return *this;
+}
+
+
+void CFLRStats::startPhase(const std::string &name)
+{
+    phases.push_back({name, 0, 0});
+    phaseStart = std::chrono::steady_clock::now();
+}
+
+
+void CFLRStats::endPhase()
+{
+    if (phases.empty())
+        return;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - phaseStart;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    phases.back().seconds = elapsed.count();
+    phases.back().peakRSSKiB = usage.ru_maxrss;
+}
+
+
+bool CFLRStats::dump(const std::string &fileName) const
+{
+    std::ofstream outFile(fileName, std::ios::out);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fileName + "!!\n";
+        return false;
+    }
+
+    outFile << "{\n  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); ++i)
+        outFile << (i ? "," : "") << "\n    {\"name\": \"" << phases[i].name << "\", \"seconds\": "
+                << phases[i].seconds << ", \"peakRSSKiB\": " << phases[i].peakRSSKiB << "}";
+    outFile << "\n  ],\n";
+
+    outFile << "  \"counters\": {\n"
+            << "    \"pushes\": " << counters.pushes << ",\n"
+            << "    \"pops\": " << counters.pops << ",\n"
+            << "    \"duplicates\": " << counters.duplicates << ",\n"
+            << "    \"maxWorkList\": " << counters.maxWorkList << ",\n"
+            << "    \"unions\": " << counters.unions << ",\n"
+            << "    \"unionHits\": " << counters.unionHits << ",\n"
+            << "    \"derived\": {";
+    for (EdgeLabel label = 0; label < NumEdgeLabels; ++label)
+        outFile << (label ? ", " : "") << "\"" << CFLRGrammar::labelName(label) << "\": " << counters.derived[label];
+    outFile << "}\n  }\n}\n";
+    return (bool) outFile;
+}
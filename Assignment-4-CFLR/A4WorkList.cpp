@@ -0,0 +1,252 @@
+/**
+ * A4WorkList.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+void CFLRWorkList::setSchedule(CFLRSchedule sched, std::vector<unsigned> rank)
+{
+    clear();
+    schedule = sched;
+    topoRank = std::move(rank);
+    unsigned numBuckets = 1;
+    if (schedule == CFLRSchedule::LabelPriority)
+    {
+        // The points-to core first, then the statements, then the intermediate labels (PV, VP, ...)
+        labelRank.assign(NumEdgeLabels, 2);
+        for (EdgeLabel label : {Addr, AddrBar, PT, PTBar})
+            labelRank[label] = 0;
+        for (EdgeLabel label : {Copy, CopyBar, Store, StoreBar, Load, LoadBar})
+            labelRank[label] = 1;
+        numBuckets = 3;
+    }
+    else if (schedule == CFLRSchedule::Topological)
+        numBuckets = TopoBuckets;
+    buckets = std::vector<FlatWorkList<CFLREdge>>(numBuckets);
+}
+
+
+void CFLRWorkList::clear()
+{
+    for (FlatWorkList<CFLREdge> &bucket : buckets)
+        bucket.clear();
+    byNode.clear();
+    nodeQueued.clear();
+    nodes.clear();
+    current = NoNode;
+    first = 0;
+    count = 0;
+}
+
+
+void CFLRWorkList::pushLocal(const CFLREdge &edge)
+{
+    if (edge.src >= byNode.size())
+    {
+        byNode.resize(edge.src + 1);
+        nodeQueued.resize(edge.src + 1, false);
+    }
+    byNode[edge.src].push_back(edge);
+    if (!nodeQueued[edge.src])
+    {
+        nodeQueued[edge.src] = true;
+        nodes.push_back(edge.src);
+    }
+}
+
+
+CFLREdge CFLRWorkList::popLocal()
+{
+    if (current == NoNode)
+    {
+        current = nodes.front();
+        nodes.pop_front();
+    }
+    std::pmr::vector<CFLREdge> &edges = byNode[current];
+    CFLREdge edge = edges.back();
+    edges.pop_back();
+    if (edges.empty())
+    {
+        nodeQueued[current] = false;
+        current = NoNode;
+    }
+    return edge;
+}
+
+
+std::array<bool, MaxEdgeLabels> CFLR::derivedLabels() const
+{
+    std::array<bool, MaxEdgeLabels> derived{};
+    for (EdgeLabel label = 0; label < graph->getLabelNum(); ++label)
+        for (EdgeLabel head : grammar.unary(label))
+            derived[head] = true;
+    for (const CFLRGrammar::Binary &rule : grammar.binaries())
+        derived[rule.head] = true;
+    return derived;
+}
+
+
+std::array<bool, MaxEdgeLabels> CFLR::mirrorableBars() const
+{
+    std::array<bool, MaxEdgeLabels> derived = derivedLabels();
+
+    std::array<bool, MaxEdgeLabels> bars{};
+    for (EdgeLabel label = 0; label + 1 < graph->getLabelNum(); label += 2)
+    {
+        EdgeLabel bar = label + 1;
+        if (derived[bar] || grammar.inverse(bar) != CFLRGrammar::NoLabel)
+            continue;
+        EdgeLabel base = graph->baseOf(label);
+        bool statement = base == Addr || base == Copy || base == Store || base == Load || base == Gep;
+        bars[bar] = grammar.inverse(label) == bar || (statement && !derived[label]);
+    }
+    return bars;
+}
+
+
+void CFLR::solve()
+{
+    stats.counters = CFLRCounters();
+    ptOf.clear();
+    // Cycle collapsing renames nodes under the memoised queries
+    queries = QueryCache();
+    addFieldProductions();
+    if (options.mirrorBars)
+        graph->mirrorBars(mirrorableBars());
+    if (options.incremental && !solved)
+        graph->forEachEdge([&](unsigned u, unsigned v, EdgeLabel lbl) {
+            baseEdges.insert(CFLREdge(u, v, lbl));
+        });
+    solved = true;
+
+    if (options.collapseCycles)
+    {
+        std::vector<unsigned> changed;
+        graph->collapseCycles(Copy, changed);
+    }
+
+    // The shared-set solver knows the points-to grammar only, and keeps no edges to update incrementally
+    bool shared = !customGrammar && graph->getLabelNum() == NumEdgeLabels && !options.incremental;
+    // The parallel solver inserts into the dense storage only; otherwise the worklist solver takes over
+    bool parallel = graph->getStorage() == CFLRStorage::Dense;
+    if (options.solver == CFLRSolver::SharedSets && !shared)
+        std::cout << "warning: the shared-set solver needs the points-to grammar without fields or updates, "
+                     "using the worklist solver\n";
+    if (options.solver == CFLRSolver::Parallel && !parallel)
+        std::cout << "warning: the parallel solver needs the dense storage, using the worklist solver\n";
+
+    if (options.solver == CFLRSolver::SharedSets && shared)
+        solveSharedSets();
+    else if (options.solver == CFLRSolver::SemiNaive)
+        solveSemiNaive();
+    else if (options.solver == CFLRSolver::Parallel && parallel)
+        solveParallel();
+    else
+        solveWorkList();
+
+    // The stats name the labels of EdgeLabelType: field-indexed labels count for their base label
+    for (EdgeLabel label = NumEdgeLabels; label < graph->getLabelNum(); ++label)
+        stats.counters.derived[graph->baseOf(label)] += stats.counters.derived[label];
+}
+
+void CFLR::solveWorkList()
+{
+    // The topological schedule orders sources along the DAG of Copy SCCs; SCC IDs are in reverse topological order
+    std::vector<unsigned> topoRank;
+    if (options.schedule == CFLRSchedule::Topological)
+    {
+        unsigned numSCCs = graph->findSCCs(Copy, topoRank);
+        for (unsigned &rank : topoRank)
+            rank = numSCCs - 1 - rank;
+    }
+    workList.setSchedule(options.schedule, std::move(topoRank));
+
+    // -------------------------------------------------------------------------
+    // 1. Initialization
+    // -------------------------------------------------------------------------
+    // Populate the worklist with all initial edges present in the graph.
+    // The graph is pre-filled by CFLRGraph constructor (A4Lib.cpp).
+    graph->forEachEdge([&](unsigned u, unsigned v, EdgeLabel lbl) {
+        pushEdge(CFLREdge(u, v, lbl));
+    });
+
+    propagate();
+}
+
+void CFLR::propagate()
+{
+    // -------------------------------------------------------------------------
+    // 0. Helper: Safe Edge Addition
+    // -------------------------------------------------------------------------
+    // Adds an edge to the graph and worklist.
+    // Also maintains the inverse edges (Bar edges) the grammar asks for, e.g. PTBar for PT
+    // and CopyBar for Copy, which are critical for rules such as CopyBar * PT and PTBar * Load.
+    // Each derived edge costs a single test-and-insert on the graph.
+    // Sources of the new Copy edges since the last cycle collapsing
+    std::vector<unsigned> newCopies;
+    CFLRCounters &counters = stats.counters;
+
+    auto addEdge = [&](unsigned u, unsigned v, EdgeLabel label) {
+        if (graph->insertIfAbsent(u, v, label)) {
+            pushEdge(CFLREdge(u, v, label));
+            ++counters.derived[label];
+            if (label == Copy && options.collapseCycles)
+                newCopies.push_back(u);
+
+            // Maintain symmetry/inverse edges required by the grammar.
+            // A mirrored inverse is already in the graph with the edge, but still has to be processed.
+            EdgeLabel inv = grammar.inverse(label);
+            if (inv != CFLRGrammar::NoLabel && (graph->insertIfAbsent(v, u, inv) || graph->isMirrored(inv))) {
+                pushEdge(CFLREdge(v, u, inv));
+                ++counters.derived[inv];
+            }
+        }
+        else
+            ++counters.duplicates;
+    };
+
+    // -------------------------------------------------------------------------
+    // 2. Main Worklist Loop
+    // -------------------------------------------------------------------------
+    // The productions are looked up in the tables compiled from the grammar (A4Grammar.cpp).
+    while (!workList.empty()) {
+        // Derived Copy edges may close new cycles: collapse the cycles through them from time to time, then
+        // revisit every edge of the representatives, whose neighbours have changed
+        if (!newCopies.empty() && newCopies.size() >= options.collapsePeriod) {
+            std::vector<unsigned> changed;
+            graph->collapseCycles(Copy, newCopies, changed);
+            newCopies.clear();
+            for (unsigned r : changed) {
+                for (EdgeLabel l = 0; l < graph->getLabelNum(); ++l) {
+                    for (unsigned w : graph->successors(r, l)) pushEdge(CFLREdge(r, w, l));
+                    for (unsigned w : graph->predecessors(r, l)) pushEdge(CFLREdge(w, r, l));
+                }
+            }
+        }
+
+        CFLREdge edge = workList.pop();
+        ++counters.pops;
+        // Edges queued before a collapse may refer to merged nodes
+        unsigned u = graph->rep(edge.src);
+        unsigned v = graph->rep(edge.dst);
+        EdgeLabel lbl = edge.label;
+
+        // === Unary Rules: A -> lbl ===
+        // e.g. AddrBar -> PT: initial p -> a (AddrBar) implies p points-to a.
+        for (EdgeLabel head : grammar.unary(lbl))
+            addEdge(u, v, head);
+
+        // === Binary Rules (Right Matching: u -> v -> w) ===
+        // A -> lbl next: we look for edges v --next--> w, e.g. (u --CopyBar--> v) * (v --PT--> w)  ==>  (u --PT--> w)
+        for (const CFLRGrammar::Entry &rule : grammar.asLeft(lbl))
+            for (unsigned w : graph->successors(v, rule.other))
+                addEdge(u, w, rule.head);
+
+        // === Binary Rules (Left Matching: w -> u -> v) ===
+        // A -> prev lbl: we look for edges w --prev--> u, e.g. (w --Store--> u) * (u --PT--> v)  ==>  (w --PV--> v)
+        for (const CFLRGrammar::Entry &rule : grammar.asRight(lbl))
+            for (unsigned w : graph->predecessors(u, rule.other))
+                addEdge(w, v, rule.head);
+    }
+}
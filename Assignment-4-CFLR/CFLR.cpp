@@ -4,162 +4,410 @@
  */
 
 #include "A4Header.h"
+#include "SVFIRArtifact.h"
+
+#include <charconv>
+#include <set>
+#include <spawn.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 using namespace SVF;
 using namespace llvm;
 using namespace std;
 
-int main(int argc, char **argv)
+static const Option<std::string> StorageKind(
+        "cflr-storage", "Storage backend of the CFLR graph (hash, dense; dense by default for the parallel solver)", "");
+static const Option<std::string> SolverKind(
+        "cflr-solver", "Fixpoint algorithm of the CFLR solver (worklist, seminaive, parallel, shared)", "worklist");
+static const Option<u32_t> SolverThreads(
+        "cflr-threads", "Threads of the parallel CFLR solver (0 for one per hardware thread)", 0);
+static const Option<std::string> Schedule(
+        "cflr-schedule", "Edge order of the worklist solver (fifo, lifo, label, locality, topo)", "fifo");
+static const Option<bool> MirrorBars(
+        "cflr-mirror-bars", "Store the Bar edges of the grammar once, as the reversed edges of their twin", false);
+static const Option<bool> CollapseCycles(
+        "cflr-scc", "Merge nodes on Copy cycles (only sound for the points-to grammar)", false);
+static const Option<std::string> QueryNodes(
+        "cflr-query", "Comma-separated pointers to query on demand instead of solving the whole program", "");
+static const Option<u32_t> QueryBudget(
+        "cflr-query-budget", "Propagation steps one demand-driven query may take", 1000000);
+static const Option<bool> BinaryResult(
+        "cflr-binary", "Also dump the results in binary form (<module>.res.bin)", false);
+static const Option<std::string> SnapshotDir(
+        "cflr-cache", "Directory of graph snapshots, reused when the input and the PAG options are unchanged", "");
+static const Option<std::string> ArtifactFile(
+        "cflr-artifact", "SVFIR artifact (<module>.svfir, written by svfir) to read the PAG from instead of a module", "");
+static const Option<std::string> DumpGraphs(
+        "cflr-dump", "Comma-separated graphs to dump (pag, initial, final)", "");
+static const Option<std::string> DumpFormat(
+        "cflr-dump-format", "Format of the dumped CFLR graphs (edges, dot)", "edges");
+static const Option<std::string> DumpLabels(
+        "cflr-dump-labels", "Comma-separated labels of the dumped CFLR graphs (all if empty)", "");
+static const Option<std::string> DumpNodes(
+        "cflr-dump-nodes", "Node range <first>-<last> of the dumped CFLR graphs (all if empty)", "");
+static const Option<std::string> StatsFile(
+        "cflr-stats", "JSON file receiving the phase timings and solver counters", "");
+static const Option<std::string> UpdateFile(
+        "cflr-update", "File of initial edges (+ src dst Label, - src dst Label) applied incrementally after solving, statements with their Bar edges", "");
+static const Option<std::string> GrammarFile(
+        "cflr-grammar", "Grammar file replacing the default points-to grammar", "");
+static const Option<u32_t> FieldLimit(
+        "cflr-field-limit", "Solve field-sensitively, with Gep fields up to the limit (0 for field-insensitive)", 0);
+static const Option<std::string> BatchFile(
+        "cflr-batch", "File of independent modules (<input> [MiB] per line) analysed side by side, with the inputs", "");
+static const Option<u32_t> BatchJobs(
+        "cflr-batch-jobs", "Modules of a batch analysed at the same time (0 for one per hardware thread)", 0);
+static const Option<u32_t> BatchMemory(
+        "cflr-batch-memory", "MiB of estimated memory the running modules of a batch may take (0 for no limit)", 0);
+
+/// Rough peak memory per byte of input, for batch entries without an estimate
+static const uint64_t ArtifactMemoryRatio = 16;
+static const uint64_t ModuleMemoryRatio = 64;
+
+/// Parse a decimal node ID that makes up the whole text
+static bool parseNode(const std::string &text, unsigned &node)
 {
-    auto moduleNameVec =
-            OptionBase::parseOptions(argc, argv, "Whole Program Points-to Analysis",
-                                     "[options] <input-bitcode...>");
+    const char *end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, node);
+    return result.ec == std::errc() && result.ptr == end;
+}
 
-    LLVMModuleSet::buildSVFModule(moduleNameVec);
+/// The filter of -cflr-dump-*; false if an option is malformed
+static bool parseDumpFilter(CFLRDumpFilter &filter)
+{
+    filter.dot = DumpFormat() == "dot";
 
-    SVFIRBuilder builder;
-    auto pag = builder.build();
-    pag->dump();
+    std::istringstream labels(DumpLabels());
+    for (std::string name; std::getline(labels, name, ',');)
+    {
+        EdgeLabel label = CFLRGrammar::labelByName(name);
+        if (label == CFLRGrammar::NoLabel)
+        {
+            std::cout << "unknown label " + name + "!!\n";
+            return false;
+        }
+        if (filter.labels.size() <= label)
+            filter.labels.resize(label + 1, false);
+        filter.labels[label] = true;
+    }
 
-    CFLR solver;
-    solver.buildGraph(pag);
-    
-    solver.solve();
-    solver.dumpResult();
+    if (!DumpNodes().empty())
+    {
+        size_t dash = DumpNodes().find('-');
+        if (dash == std::string::npos || !parseNode(DumpNodes().substr(0, dash), filter.minNode) ||
+            !parseNode(DumpNodes().substr(dash + 1), filter.maxNode) || filter.minNode > filter.maxNode)
+        {
+            std::cout << "malformed node range " + DumpNodes() + "!!\n";
+            return false;
+        }
+    }
+    return true;
+}
 
-    LLVMModuleSet::releaseLLVMModuleSet();
-    return 0;
+static bool isArtifact(const std::string &input)
+{
+    return input.size() > 6 && input.compare(input.size() - 6, 6, ".svfir") == 0;
 }
 
-void CFLR::solve()
+/**
+ * Builds the batch of -cflr-batch and of the inputs.  An entry is estimated from the size of its file
+ * unless its line gives the MiB it needs.
+ */
+static bool readBatch(const std::vector<std::string> &inputs, CFLRBatch &batch)
 {
-    // -------------------------------------------------------------------------
-    // 0. Helper: Safe Edge Addition
-    // -------------------------------------------------------------------------
-    // Adds an edge to the graph and worklist.
-    // Also maintains the necessary inverse edges (Bar edges) for PT and Copy
-    // which are critical for the grammar rules (CopyBar * PT, PTBar * Load).
-    auto addEdge = [&](unsigned u, unsigned v, EdgeLabel label) {
-        if (!graph->hasEdge(u, v, label)) {
-            graph->addEdge(u, v, label);
-            workList.push(CFLREdge(u, v, label));
-
-            // Maintain symmetry/inverse edges required by the grammar
-            if (label == PT) {
-                // If u -> v (PT), add v -> u (PTBar)
-                if (!graph->hasEdge(v, u, PTBar)) {
-                    graph->addEdge(v, u, PTBar);
-                    workList.push(CFLREdge(v, u, PTBar));
-                }
-            } else if (label == Copy) {
-                // If u -> v (Copy), add v -> u (CopyBar)
-                if (!graph->hasEdge(v, u, CopyBar)) {
-                    graph->addEdge(v, u, CopyBar);
-                    workList.push(CFLREdge(v, u, CopyBar));
-                }
-            }
+    std::vector<std::pair<std::string, uint64_t>> entries;
+    for (const std::string &input : inputs)
+        entries.push_back({input, 0});
+    if (!BatchFile().empty())
+    {
+        std::ifstream inFile(BatchFile(), std::ios::in);
+        if (!inFile)
+        {
+            std::cout << "error opening " + BatchFile() + "!!\n";
+            return false;
         }
-    };
-
-    // -------------------------------------------------------------------------
-    // 1. Initialization
-    // -------------------------------------------------------------------------
-    // Populate the worklist with all initial edges present in the graph.
-    // The graph is pre-filled by CFLRGraph constructor (A4Lib.cpp).
-    for (const auto &srcMap : graph->getSuccessorMap()) {
-        unsigned u = srcMap.first;
-        for (const auto &lblMap : srcMap.second) {
-            EdgeLabel lbl = lblMap.first;
-            for (unsigned v : lblMap.second) {
-                workList.push(CFLREdge(u, v, lbl));
+        std::string line;
+        for (unsigned lineNo = 1; std::getline(inFile, line); ++lineNo)
+        {
+            std::istringstream tokens(line);
+            std::string input;
+            if (!(tokens >> input) || input[0] == '#')
+                continue;
+            uint64_t mib = 0;
+            if (!(tokens >> mib) && !tokens.eof())
+            {
+                std::cout << BatchFile() << ":" << lineNo << ": malformed batch entry '" << line << "'\n";
+                return false;
             }
+            entries.push_back({input, mib << 20});
         }
     }
 
-    // -------------------------------------------------------------------------
-    // 2. Main Worklist Loop
-    // -------------------------------------------------------------------------
-    while (!workList.empty()) {
-        CFLREdge edge = workList.pop();
-        unsigned u = edge.src;
-        unsigned v = edge.dst;
-        EdgeLabel lbl = edge.label;
-
-        // === Unary Rules ===
-        // Rule: AddrBar -> PT
-        // Initial p -> a (AddrBar) implies p points-to a.
-        if (lbl == AddrBar) {
-            addEdge(u, v, PT);
+    for (auto &entry : entries)
+    {
+        uint64_t memory = entry.second;
+        if (memory == 0)
+        {
+            struct stat st;
+            if (stat(entry.first.c_str(), &st) != 0)
+            {
+                std::cout << "error opening " + entry.first + "!!\n";
+                return false;
+            }
+            memory = st.st_size * (isArtifact(entry.first) ? ArtifactMemoryRatio : ModuleMemoryRatio);
         }
+        batch.add(entry.first, memory);
+    }
+    return true;
+}
 
-        // === Binary Rules (Right Matching: u -> v -> w) ===
-        // We look for edges v --nextLbl--> w
-        if (graph->getSuccessorMap().count(v)) {
-            const auto &succs = graph->getSuccessorMap()[v];
-
-            // Rule: CopyBar * PT -> PT
-            // (u --CopyBar--> v) * (v --PT--> w)  ==>  (u --PT--> w)
-            if (lbl == CopyBar) {
-                if (succs.count(PT)) {
-                    for (unsigned w : succs.at(PT)) addEdge(u, w, PT);
-                }
-            }
-            // Rule: Store * PT -> PV
-            // (u --Store--> v) * (v --PT--> w)  ==>  (u --PV--> w)
-            else if (lbl == Store) {
-                if (succs.count(PT)) {
-                    for (unsigned w : succs.at(PT)) addEdge(u, w, PV);
-                }
-            }
-            // Rule: PTBar * Load -> VP
-            // (u --PTBar--> v) * (v --Load--> w)  ==>  (u --VP--> w)
-            else if (lbl == PTBar) {
-                if (succs.count(Load)) {
-                    for (unsigned w : succs.at(Load)) addEdge(u, w, VP);
-                }
-            }
-            // Rule: PV * VP -> Copy
-            // (u --PV--> v) * (v --VP--> w)  ==>  (u --Copy--> w)
-            else if (lbl == PV) {
-                if (succs.count(VP)) {
-                    for (unsigned w : succs.at(VP)) addEdge(u, w, Copy);
-                }
-            }
+/// Solve the PAG of an artifact with a solver of its own, so that several artifacts can be solved at once
+static bool runArtifact(const std::string &fileName, const CFLROptions &options, const CFLRGrammar *grammar,
+                        const std::set<std::string> &dumps, const CFLRDumpFilter &dumpFilter)
+{
+    CFLR solver(options);
+    if (grammar)
+        solver.setGrammar(*grammar);
+    if (!solver.loadArtifact(fileName))
+        return false;
+    if (dumps.count("initial"))
+        solver.dumpGraph("initial", dumpFilter);
+    solver.solve();
+    if (dumps.count("final"))
+        solver.dumpGraph("final", dumpFilter);
+    solver.dumpResult();
+    if (BinaryResult())
+        solver.dumpBinaryResult();
+    return true;
+}
+
+/**
+ * Analyse a module in a cflr process of its own, as LLVM and SVF keep one module per process.
+ * The process gets the options of this one, without the batch options and -cflr-stats.
+ */
+static bool runModule(const std::string &module, int argc, char **argv)
+{
+    std::vector<char *> args = {argv[0]};
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t name = arg.find_first_not_of('-');
+        if (name == 0 || name == std::string::npos)
+            continue;
+        if (arg.compare(name, 10, "cflr-batch") != 0 && arg.compare(name, 10, "cflr-stats") != 0)
+            args.push_back(argv[i]);
+    }
+    args.push_back(const_cast<char *>(module.c_str()));
+    args.push_back(nullptr);
+
+    pid_t pid;
+    int status;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, args.data(), environ) != 0 ||
+        waitpid(pid, &status, 0) != pid)
+    {
+        std::cout << "error running " + std::string(argv[0]) + " on " + module + "!!\n";
+        return false;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::cout << "analysis of " + module + " failed!!\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    auto moduleNameVec =
+            SVFIRArtifact::parseOptions(argc, argv, "Whole Program Points-to Analysis",
+                                        "[options] <input-bitcode...>");
+
+    CFLROptions options;
+    // The hash storage takes less memory on sparse PAGs; the parallel solver needs the dense one
+    if (StorageKind() == "dense" || (StorageKind().empty() && SolverKind() == "parallel"))
+        options.storage = CFLRStorage::Dense;
+    else if (!StorageKind().empty() && StorageKind() != "hash")
+    {
+        std::cout << "unknown storage " + StorageKind() + "!!\n";
+        return 1;
+    }
+    if (SolverKind() == "seminaive")
+        options.solver = CFLRSolver::SemiNaive;
+    else if (SolverKind() == "parallel")
+        options.solver = CFLRSolver::Parallel;
+    else if (SolverKind() == "shared")
+        options.solver = CFLRSolver::SharedSets;
+    else if (SolverKind() != "worklist")
+    {
+        std::cout << "unknown solver " + SolverKind() + "!!\n";
+        return 1;
+    }
+    if (options.solver == CFLRSolver::Parallel && options.storage != CFLRStorage::Dense)
+    {
+        std::cout << "-cflr-solver=parallel needs -cflr-storage=dense!!\n";
+        return 1;
+    }
+    if (Schedule() == "lifo")
+        options.schedule = CFLRSchedule::LIFO;
+    else if (Schedule() == "label")
+        options.schedule = CFLRSchedule::LabelPriority;
+    else if (Schedule() == "locality")
+        options.schedule = CFLRSchedule::NodeLocality;
+    else if (Schedule() == "topo")
+        options.schedule = CFLRSchedule::Topological;
+    else if (Schedule() != "fifo")
+    {
+        std::cout << "unknown schedule " + Schedule() + "!!\n";
+        return 1;
+    }
+    options.threads = SolverThreads();
+    options.collapseCycles = CollapseCycles();
+    options.mirrorBars = MirrorBars();
+    options.queryBudget = QueryBudget();
+    options.incremental = !UpdateFile().empty();
+    options.fieldLimit = FieldLimit();
+    if (options.fieldLimit > MaxFieldLimit)
+    {
+        std::cout << "-cflr-field-limit must not exceed " << MaxFieldLimit << "!!\n";
+        return 1;
+    }
+
+    std::set<std::string> dumps;
+    std::istringstream dumpNames(DumpGraphs());
+    for (std::string name; std::getline(dumpNames, name, ',');)
+        dumps.insert(name);
+    CFLRDumpFilter dumpFilter;
+    if (!parseDumpFilter(dumpFilter))
+        return 1;
+
+    CFLRGrammar grammar;
+    if (!GrammarFile().empty() && !grammar.load(GrammarFile()))
+        return 1;
+
+    // Batch mode: every input is a module of its own, with its own solver and result file
+    if (!BatchFile().empty())
+    {
+        // Each entry is an input of its own, and the module entries run in processes that would get these options too
+        if (!QueryNodes().empty() || !UpdateFile().empty() || !ArtifactFile().empty() || !SnapshotDir().empty())
+        {
+            std::cout << "-cflr-query, -cflr-update, -cflr-artifact and -cflr-cache take a single module!!\n";
+            return 1;
         }
+        CFLRBatch batch(BatchJobs(), (uint64_t) BatchMemory() << 20);
+        if (!readBatch(moduleNameVec, batch))
+            return 1;
+        const CFLRGrammar *customGrammar = GrammarFile().empty() ? nullptr : &grammar;
+        unsigned failed = batch.run([&](const std::string &input) {
+            if (isArtifact(input))
+                return runArtifact(input, options, customGrammar, dumps, dumpFilter);
+            return runModule(input, argc, argv);
+        });
+        return failed ? 1 : 0;
+    }
 
-        // === Binary Rules (Left Matching: w -> u -> v) ===
-        // We look for edges w --prevLbl--> u
-        if (graph->getPredecessorMap().count(u)) {
-            const auto &preds = graph->getPredecessorMap()[u];
-
-            // Triggered when the current edge (u->v) is the *second* part of a rule
-            
-            if (lbl == PT) {
-                // Rule: CopyBar * PT -> PT
-                // (w --CopyBar--> u) * (u --PT--> v)
-                if (preds.count(CopyBar)) {
-                    for (unsigned w : preds.at(CopyBar)) addEdge(w, v, PT);
-                }
-                // Rule: Store * PT -> PV
-                // (w --Store--> u) * (u --PT--> v)
-                if (preds.count(Store)) {
-                    for (unsigned w : preds.at(Store)) addEdge(w, v, PV);
-                }
-            }
-            else if (lbl == Load) {
-                // Rule: PTBar * Load -> VP
-                // (w --PTBar--> u) * (u --Load--> v)
-                if (preds.count(PTBar)) {
-                    for (unsigned w : preds.at(PTBar)) addEdge(w, v, VP);
-                }
-            }
-            else if (lbl == VP) {
-                // Rule: PV * VP -> Copy
-                // (w --PV--> u) * (u --VP--> v)
-                if (preds.count(PV)) {
-                    for (unsigned w : preds.at(PV)) addEdge(w, v, Copy);
-                }
+    CFLR solver(options);
+    if (!GrammarFile().empty())
+        solver.setGrammar(grammar);
+
+    // A warm run loads the graph from its snapshot and skips LLVM and SVF altogether
+    std::string snapshot;
+    uint64_t key = 0;
+    if (!SnapshotDir().empty())
+    {
+        key = CFLR::snapshotKey(moduleNameVec, argc, argv);
+        char keyText[17];
+        snprintf(keyText, sizeof(keyText), "%016llx", (unsigned long long) key);
+        snapshot = SnapshotDir() + "/" + keyText + ".cflrsnap";
+    }
+    CFLRStats &stats = solver.getStats();
+    bool moduleBuilt = true;
+    if (!ArtifactFile().empty())
+    {
+        stats.startPhase("load-artifact");
+        if (!solver.loadArtifact(ArtifactFile()))
+            return 1;
+        stats.endPhase();
+        moduleBuilt = false;
+    }
+    else if (!snapshot.empty())
+    {
+        stats.startPhase("load-snapshot");
+        moduleBuilt = !solver.loadSnapshot(snapshot, key);
+        stats.endPhase();
+    }
+    if (moduleBuilt)
+    {
+        stats.startPhase("build-module");
+        LLVMModuleSet::buildSVFModule(moduleNameVec);
+        stats.endPhase();
+
+        stats.startPhase("build-pag");
+        SVFIRBuilder builder;
+        auto pag = builder.build();
+        stats.endPhase();
+        if (dumps.count("pag"))
+            pag->dump(pag->getModuleIdentifier() + ".pag");
+
+        stats.startPhase("build-graph");
+        solver.buildGraph(pag);
+        stats.endPhase();
+        if (!snapshot.empty())
+            solver.saveSnapshot(snapshot, key);
+    }
+    if (dumps.count("initial"))
+        solver.dumpGraph("initial", dumpFilter);
+
+    if (!QueryNodes().empty())
+    {
+        // Demand-driven mode: answer the queries on stdout, in the format of the result file
+        std::vector<unsigned> ids;
+        std::istringstream nodes(QueryNodes());
+        for (std::string node; std::getline(nodes, node, ',');)
+        {
+            ids.push_back(0);
+            if (!parseNode(node, ids.back()))
+            {
+                std::cout << "malformed node " + node + " in -cflr-query!!\n";
+                return 1;
             }
         }
+        for (unsigned id : ids)
+        {
+            NodeBS pts;
+            if (!solver.queryPointsTo(id, pts))
+                std::cout << "# budget exhausted, incomplete result for " << id << '\n';
+            for (unsigned o : pts)
+                std::cout << id << '\t' << "points to" << '\t' << o << '\n';
+        }
+        if (moduleBuilt)
+            LLVMModuleSet::releaseLLVMModuleSet();
+        return 0;
+    }
+
+    stats.startPhase("solve");
+    solver.solve();
+    stats.endPhase();
+    if (!UpdateFile().empty())
+    {
+        stats.startPhase("update");
+        if (!solver.applyUpdates(UpdateFile()))
+            return 1;
+        stats.endPhase();
     }
+    if (dumps.count("final"))
+        solver.dumpGraph("final", dumpFilter);
+
+    stats.startPhase("dump-result");
+    solver.dumpResult();
+    if (BinaryResult())
+        solver.dumpBinaryResult();
+    stats.endPhase();
+    if (!StatsFile().empty())
+        stats.dump(StatsFile());
+
+    if (moduleBuilt)
+        LLVMModuleSet::releaseLLVMModuleSet();
+    return 0;
 }
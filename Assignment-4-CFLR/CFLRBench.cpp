@@ -0,0 +1,222 @@
+/**
+ * CFLRBench.cpp
+ * Times the CFLR solvers and storage backends on synthetic graphs.
+ *
+ * usage: cflr-bench [<shape>|all] [<nodes>...]
+ *   shapes: chain, cycle, fanin, list (default all, at 10^3 to 10^7 nodes)
+ * Each run gets RunSeconds and half the physical memory; runs beyond either are reported, not waited for.
+ * The graphs take about 200 bytes per edge, so 10^7 nodes need upwards of 8 GiB; the semi-naive solver
+ * takes one round per hop on chains and lists and runs out of time from 10^6 nodes on.
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+
+/// A PAG statement: the edge and its Bar edge, as added by the CFLRGraph constructor
+void addStmt(CFLRGraph *graph, unsigned src, unsigned dst, EdgeLabel label)
+{
+    graph->addEdge(src, dst, label);
+    graph->addEdge(dst, src, label + 1);
+}
+
+/// p_1 = &o; p_2 = p_1; ...; p_n-1 = p_n-2
+void genChain(CFLRGraph *graph, unsigned nodes)
+{
+    addStmt(graph, 0, 1, Addr);
+    for (unsigned p = 1; p + 1 < nodes; ++p)
+        addStmt(graph, p, p + 1, Copy);
+}
+
+/// A Copy cycle through every pointer, with 16 objects taken along it: every pointer points to all of them
+void genCycle(CFLRGraph *graph, unsigned nodes)
+{
+    const unsigned NumObjects = 16;
+    unsigned first = NumObjects;
+    unsigned pointers = nodes > first + 1 ? nodes - first : 1;
+    for (unsigned p = 0; p < pointers; ++p)
+        addStmt(graph, first + p, first + (p + 1) % pointers, Copy);
+    for (unsigned o = 0; o < NumObjects; ++o)
+        addStmt(graph, o, first + (uint64_t) o * pointers / NumObjects, Addr);
+}
+
+/// Groups of 64 writers storing into one cell (*q = w_i) and 64 readers loading from it (r_j = *q)
+void genFanIn(CFLRGraph *graph, unsigned nodes)
+{
+    const unsigned Width = 64;
+    const unsigned GroupSize = 3 * Width + 2;
+    for (unsigned base = 0; base + GroupSize <= std::max(nodes, GroupSize); base += GroupSize)
+    {
+        unsigned cell = base, q = base + 1;
+        addStmt(graph, cell, q, Addr);
+        for (unsigned i = 0; i < Width; ++i)
+        {
+            unsigned obj = base + 2 + i, writer = base + 2 + Width + i, reader = base + 2 + 2 * Width + i;
+            addStmt(graph, obj, writer, Addr);
+            addStmt(graph, writer, q, Store);
+            addStmt(graph, q, reader, Load);
+        }
+    }
+}
+
+/// A heap-allocated list, as in Test-Cases/heap-linkedlist.c: p_i = malloc(); p_i->next = p_i+1,
+/// then walked with t_0 = p_0; t_i+1 = t_i->next
+void genList(CFLRGraph *graph, unsigned nodes)
+{
+    unsigned cells = std::max(nodes / 3, 2u);
+    auto obj = [](unsigned i) { return 3 * i; };
+    auto ptr = [](unsigned i) { return 3 * i + 1; };
+    auto walk = [](unsigned i) { return 3 * i + 2; };
+    for (unsigned i = 0; i < cells; ++i)
+    {
+        addStmt(graph, obj(i), ptr(i), Addr);
+        if (i + 1 < cells)
+            addStmt(graph, ptr(i + 1), ptr(i), Store);
+    }
+    addStmt(graph, ptr(0), walk(0), Copy);
+    for (unsigned i = 0; i + 1 < cells; ++i)
+        addStmt(graph, walk(i), walk(i + 1), Load);
+}
+
+struct Shape
+{
+    const char *name;
+    void (*generate)(CFLRGraph *, unsigned);
+};
+
+const Shape Shapes[] = {{"chain", genChain}, {"cycle", genCycle}, {"fanin", genFanIn}, {"list", genList}};
+
+struct Config
+{
+    const char *name;
+    CFLRSolver solver;
+    CFLRStorage storage;
+    CFLRSchedule schedule;
+};
+
+const Config Configs[] = {
+        {"worklist/dense", CFLRSolver::WorkList, CFLRStorage::Dense, CFLRSchedule::FIFO},
+        {"worklist/hash", CFLRSolver::WorkList, CFLRStorage::HashMap, CFLRSchedule::FIFO},
+        {"lifo/hash", CFLRSolver::WorkList, CFLRStorage::HashMap, CFLRSchedule::LIFO},
+        {"label/hash", CFLRSolver::WorkList, CFLRStorage::HashMap, CFLRSchedule::LabelPriority},
+        {"locality/hash", CFLRSolver::WorkList, CFLRStorage::HashMap, CFLRSchedule::NodeLocality},
+        {"topo/hash", CFLRSolver::WorkList, CFLRStorage::HashMap, CFLRSchedule::Topological},
+        {"seminaive/dense", CFLRSolver::SemiNaive, CFLRStorage::Dense, CFLRSchedule::FIFO},
+        {"seminaive/hash", CFLRSolver::SemiNaive, CFLRStorage::HashMap, CFLRSchedule::FIFO},
+        {"parallel/dense", CFLRSolver::Parallel, CFLRStorage::Dense, CFLRSchedule::FIFO},
+        {"shared/hash", CFLRSolver::SharedSets, CFLRStorage::HashMap, CFLRSchedule::FIFO},
+};
+
+/// Wall-clock limit of one run
+const unsigned RunSeconds = 120;
+/// Exit status of a run that ran out of memory
+const int OutOfMemory = 2;
+
+/// Limit the address space of the calling process to half the physical memory
+void limitMemory()
+{
+    struct rlimit limit;
+    limit.rlim_cur = limit.rlim_max = (rlim_t) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 2;
+    setrlimit(RLIMIT_AS, &limit);
+}
+
+long peakRSSKiB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/// Runs one benchmark and prints its row.  Called in a child process, so that the peak RSS is its own.
+void run(const Shape &shape, unsigned nodes, const Config &config)
+{
+    long baseRSS = peakRSSKiB();
+
+    CFLROptions options;
+    options.solver = config.solver;
+    options.storage = config.storage;
+    options.schedule = config.schedule;
+    CFLR solver(options);
+    CFLRGraph *graph = new CFLRGraph(nodes, config.storage);
+    shape.generate(graph, nodes);
+    solver.setGraph(graph, shape.name);
+
+    uint64_t initial = 0;
+    graph->forEachEdge([&](unsigned, unsigned, EdgeLabel) { ++initial; });
+
+    CFLRStats &stats = solver.getStats();
+    stats.startPhase("solve");
+    solver.solve();
+    stats.endPhase();
+
+    uint64_t derived = 0;
+    for (uint64_t n : stats.counters.derived)
+        derived += n;
+    double seconds = stats.getPhases().back().seconds;
+    double bytesPerEdge = (stats.getPhases().back().peakRSSKiB - baseRSS) * 1024.0 / (initial + derived);
+
+    printf("%-6s %10u %-16s %12llu %12llu %10.3f %14.0f %10.1f\n", shape.name, nodes, config.name,
+           (unsigned long long) initial, (unsigned long long) derived, seconds,
+           seconds > 0 ? derived / seconds : 0.0, bytesPerEdge);
+    fflush(stdout);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = argc > 1 ? argv[1] : "all";
+    std::vector<unsigned> sizes;
+    for (int i = 2; i < argc; ++i)
+        sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    if (sizes.empty())
+        sizes = {1000, 10000, 100000, 1000000, 10000000};
+
+    printf("%-6s %10s %-16s %12s %12s %10s %14s %10s\n", "shape", "nodes", "solver", "initial", "derived",
+           "seconds", "edges/sec", "bytes/edge");
+    for (const Shape &shape : Shapes)
+    {
+        if (std::strcmp(only, "all") != 0 && std::strcmp(only, shape.name) != 0)
+            continue;
+        for (unsigned nodes : sizes)
+            for (const Config &config : Configs)
+            {
+                fflush(stdout);
+                pid_t pid = fork();
+                if (pid == 0)
+                {
+                    limitMemory();
+                    alarm(RunSeconds);
+                    try
+                    {
+                        run(shape, nodes, config);
+                    }
+                    catch (const std::bad_alloc &)
+                    {
+                        _exit(OutOfMemory);
+                    }
+                    _exit(0);
+                }
+                int status = 0;
+                waitpid(pid, &status, 0);
+                if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+                    printf("%-6s %10u %-16s over %us\n", shape.name, nodes, config.name, RunSeconds);
+                else if (WIFEXITED(status) && WEXITSTATUS(status) == OutOfMemory)
+                    printf("%-6s %10u %-16s over the memory limit\n", shape.name, nodes, config.name);
+                else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                    printf("%-6s %10u %-16s failed\n", shape.name, nodes, config.name);
+            }
+    }
+    return 0;
+}
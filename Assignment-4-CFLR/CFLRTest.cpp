@@ -0,0 +1,752 @@
+/**
+ * CFLRTest.cpp
+ * Checks the CFLR solvers against the worklist solver, and the file formats by round trips.  Run by ctest.
+ *
+ * usage: cflr-test [<input-bitcode>]
+ *   without input: synthetic graphs and the file formats
+ *   with input: every solver on the PAG of the module
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+#include "A4Result.h"
+#include "SVFIRArtifact.h"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <set>
+
+using namespace SVF;
+using namespace llvm;
+using namespace std;
+
+namespace
+{
+
+unsigned failures = 0;
+
+void check(bool ok, const std::string &what)
+{
+    if (!ok)
+    {
+        ++failures;
+        std::cout << "FAIL: " << what << "\n";
+    }
+}
+
+/// The points-to sets of every node
+using Solution = std::vector<CFLRGraph::NodeSet>;
+
+/// A solver configuration, compared against the worklist solver on the hash storage
+struct Config
+{
+    std::string name;
+    CFLROptions options;
+};
+
+std::vector<Config> configs()
+{
+    std::vector<Config> all;
+    auto add = [&all](const std::string &name, CFLRSolver solver, CFLRStorage storage, unsigned threads = 0) {
+        CFLROptions options;
+        options.solver = solver;
+        options.storage = storage;
+        options.threads = threads;
+        all.push_back({name, options});
+    };
+    add("worklist/dense", CFLRSolver::WorkList, CFLRStorage::Dense);
+    add("seminaive/hash", CFLRSolver::SemiNaive, CFLRStorage::HashMap);
+    add("seminaive/dense", CFLRSolver::SemiNaive, CFLRStorage::Dense);
+    add("parallel/1", CFLRSolver::Parallel, CFLRStorage::Dense, 1);
+    add("parallel/4", CFLRSolver::Parallel, CFLRStorage::Dense, 4);
+    add("shared/hash", CFLRSolver::SharedSets, CFLRStorage::HashMap);
+    add("shared/dense", CFLRSolver::SharedSets, CFLRStorage::Dense);
+    // Cycles collapsed up front only, and again after every (few) new Copy edges
+    for (unsigned period : {~0u, 1u, 16u})
+        for (CFLRStorage storage : {CFLRStorage::HashMap, CFLRStorage::Dense})
+        {
+            CFLROptions options;
+            options.storage = storage;
+            options.collapseCycles = true;
+            options.collapsePeriod = period;
+            all.push_back({"scc/" + std::to_string(period) + (storage == CFLRStorage::Dense ? "/dense" : "/hash"),
+                           options});
+        }
+    // Every schedule of the worklist reaches the same fixpoint, also when cycles are collapsed on the way
+    const std::pair<const char *, CFLRSchedule> schedules[] = {
+            {"lifo", CFLRSchedule::LIFO}, {"label", CFLRSchedule::LabelPriority},
+            {"locality", CFLRSchedule::NodeLocality}, {"topo", CFLRSchedule::Topological}};
+    for (auto &schedule : schedules)
+        for (bool collapse : {false, true})
+            for (CFLRStorage storage : {CFLRStorage::HashMap, CFLRStorage::Dense})
+            {
+                CFLROptions options;
+                options.schedule = schedule.second;
+                options.storage = storage;
+                options.collapseCycles = collapse;
+                options.collapsePeriod = 16;
+                all.push_back({std::string(schedule.first) + (collapse ? "/scc" : "") +
+                               (storage == CFLRStorage::Dense ? "/dense" : "/hash"), options});
+            }
+    // The Bar edges the grammar allows only once, read through their mirrored twins
+    size_t unmirrored = all.size();
+    add("worklist/hash", CFLRSolver::WorkList, CFLRStorage::HashMap);
+    add("worklist/dense", CFLRSolver::WorkList, CFLRStorage::Dense);
+    add("seminaive/hash", CFLRSolver::SemiNaive, CFLRStorage::HashMap);
+    add("seminaive/dense", CFLRSolver::SemiNaive, CFLRStorage::Dense);
+    add("parallel/1", CFLRSolver::Parallel, CFLRStorage::Dense, 1);
+    add("parallel/4", CFLRSolver::Parallel, CFLRStorage::Dense, 4);
+    for (size_t i = unmirrored; i < all.size(); ++i)
+    {
+        all[i].name = "mirrored/" + all[i].name;
+        all[i].options.mirrorBars = true;
+    }
+    return all;
+}
+
+/// Solve with the given options; build puts the initial graph, in the given storage, into the solver
+Solution solve(const CFLROptions &options, unsigned numNodes, const std::function<void(CFLR &, CFLRStorage)> &build)
+{
+    CFLR solver(options);
+    build(solver, options.storage);
+    solver.solve();
+    Solution pts(numNodes);
+    for (unsigned node = 0; node < numNodes; ++node)
+        pts[node] = solver.pointsTo(node);
+    return pts;
+}
+
+/// Check every configuration against the worklist solver
+void checkSolvers(const std::string &input, unsigned numNodes, const std::function<void(CFLR &, CFLRStorage)> &build)
+{
+    Solution expected = solve(CFLROptions(), numNodes, build);
+    for (const Config &config : configs())
+        check(solve(config.options, numNodes, build) == expected, config.name + " on " + input);
+}
+
+/// The statements of a PAG, each with its Bar edge, as the CFLRGraph constructor adds them
+struct Program
+{
+    unsigned numNodes;
+    std::vector<CFLREdge> edges;
+
+    void add(unsigned src, unsigned dst, EdgeLabel label)
+    {
+        edges.emplace_back(src, dst, label);
+        edges.emplace_back(dst, src, label + 1);
+    }
+
+    void build(CFLR &solver, CFLRStorage storage, const std::string &name) const
+    {
+        CFLRGraph *graph = new CFLRGraph(numNodes, storage);
+        graph->addEdges(edges);
+        solver.setGraph(graph, name);
+    }
+};
+
+/// A random program whose first quarter of nodes are objects, with few statements per node so sets stay small
+Program randomProgram(unsigned numNodes, unsigned numStmts, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    unsigned numObjects = numNodes / 4;
+    auto object = [&]() { return (unsigned) (rng() % numObjects); };
+    auto pointer = [&]() { return numObjects + (unsigned) (rng() % (numNodes - numObjects)); };
+    Program program{numNodes, {}};
+    for (unsigned i = 0; i < numStmts; ++i)
+    {
+        unsigned kind = rng() % 10;
+        if (kind < 2)
+            program.add(object(), pointer(), Addr);
+        else if (kind < 6)
+            program.add(pointer(), pointer(), Copy);
+        else if (kind < 8)
+            program.add(pointer(), pointer(), Store);
+        else
+            program.add(pointer(), pointer(), Load);
+    }
+    return program;
+}
+
+/// Copy cycles with objects stored and loaded around them
+Program cyclicProgram(unsigned numNodes)
+{
+    const unsigned NumObjects = 8;
+    Program program{numNodes, {}};
+    unsigned pointers = numNodes - NumObjects;
+    for (unsigned p = 0; p < pointers; ++p)
+        program.add(NumObjects + p, NumObjects + (p + 1) % pointers, Copy);
+    for (unsigned o = 0; o < NumObjects; ++o)
+    {
+        program.add(o, NumObjects + o * pointers / NumObjects, Addr);
+        program.add(NumObjects + o, NumObjects + (o * 7 + 3) % pointers, Store);
+        program.add(NumObjects + (o * 5 + 1) % pointers, NumObjects + (o * 3 + 2) % pointers, Load);
+    }
+    return program;
+}
+
+/// Demand-driven queries against the full solve: unsolved, resumed after running out of budget, and on the
+/// merged nodes of a solve that collapsed cycles
+void checkQueries(const std::string &input, const Program &program)
+{
+    auto build = [&](CFLR &solver, CFLRStorage storage) { program.build(solver, storage, input); };
+    Solution expected = solve(CFLROptions(), program.numNodes, build);
+
+    CFLROptions tight;
+    tight.queryBudget = 16;
+    CFLROptions collapsing;
+    collapsing.collapseCycles = true;
+    for (const CFLROptions &options : {CFLROptions(), tight, collapsing})
+    {
+        std::string name = "queries" + std::string(options.queryBudget == tight.queryBudget ? "/budget" :
+                                                   options.collapseCycles ? "/scc" : "") + " on " + input;
+        CFLR solver(options);
+        build(solver, options.storage);
+        if (options.collapseCycles)
+            solver.solve();
+        bool ok = true;
+        unsigned resumed = 0;
+        for (unsigned node = 0; node < program.numNodes && ok; ++node)
+        {
+            CFLRGraph::NodeSet pts;
+            // Each resumed query propagates another budget of facts, so a finite program is done eventually
+            unsigned tries = 0;
+            while (!solver.queryPointsTo(node, pts) && ++tries < 1000000)
+                ++resumed;
+            ok = pts == expected[node];
+        }
+        check(ok, name);
+        if (options.queryBudget == tight.queryBudget)
+            check(resumed > 0, name + ": resumed queries");
+    }
+}
+
+void checkSynthetic()
+{
+    std::vector<std::pair<std::string, Program>> programs;
+    for (unsigned seed = 1; seed <= 20; ++seed)
+        programs.push_back({"random-" + std::to_string(seed), randomProgram(40 + seed * 10, 60 + seed * 8, seed)});
+    programs.push_back({"cycle", cyclicProgram(200)});
+
+    for (auto &named : programs)
+    {
+        const Program &program = named.second;
+        checkSolvers(named.first, program.numNodes, [&](CFLR &solver, CFLRStorage storage) {
+            program.build(solver, storage, named.first);
+        });
+        checkQueries(named.first, program);
+    }
+}
+
+/// Statements with Gep offsets, whose field labels are interned by the graph they are added to
+struct FieldProgram
+{
+    struct Stmt
+    {
+        unsigned src, dst;
+        EdgeLabel label;
+        int64_t field;
+    };
+    unsigned numNodes;
+    std::vector<Stmt> stmts;
+
+    void build(CFLR &solver, CFLRStorage storage, unsigned fieldLimit, const std::string &name) const
+    {
+        CFLRGraph *graph = new CFLRGraph(numNodes, storage);
+        std::vector<CFLREdge> edges;
+        for (const Stmt &stmt : stmts)
+        {
+            EdgeLabel label = stmt.label == Gep ? graph->gepLabel(stmt.field, fieldLimit) : stmt.label;
+            edges.emplace_back(stmt.src, stmt.dst, label);
+            edges.emplace_back(stmt.dst, stmt.src, label ^ 1);
+        }
+        graph->addEdges(edges);
+        solver.setGraph(graph, name);
+    }
+};
+
+/// Field-sensitive runs of every configuration against points-to sets worked out by hand: a store and a load
+/// meet only through the same field, and nested Geps add up their offsets, clamped at the field limit
+void checkFields()
+{
+    // Objects o, a, b; p = &o, x = &a, y = &b
+    enum { O, A, B, P, X, Y, Q1, Q2, R1, L1, L2, L0, S1, S2, S3, T, LS1, LS2, LT, NumNodes };
+    FieldProgram program{NumNodes, {{O, P, Addr, 0}, {A, X, Addr, 0}, {B, Y, Addr, 0}}};
+    // q1 = &p->f1, q2 = &p->f2, r1 = &p->f1; *q1 = x, *q2 = y; l1 = *r1, l2 = *q2, l0 = *p
+    program.stmts.insert(program.stmts.end(), {{P, Q1, Gep, 1}, {P, Q2, Gep, 2}, {P, R1, Gep, 1},
+                                                {X, Q1, Store, 0}, {Y, Q2, Store, 0},
+                                                {R1, L1, Load, 0}, {Q2, L2, Load, 0}, {P, L0, Load, 0}});
+    // s1 = &p->f1, s2 = &s1->f1, s3 = &s2->f1, t = &p->f5; *s3 = x; ls1 = *s1, ls2 = *s2, lt = *t
+    program.stmts.insert(program.stmts.end(), {{P, S1, Gep, 1}, {S1, S2, Gep, 1}, {S2, S3, Gep, 1},
+                                                {P, T, Gep, 5}, {X, S3, Store, 0},
+                                                {S1, LS1, Load, 0}, {S2, LS2, Load, 0}, {T, LT, Load, 0}});
+
+    // Under the limit 2, s3 and t clamp to field 2 along with q2; under 3, s3 stays apart in field 3
+    using Expected = std::vector<std::pair<unsigned, CFLRGraph::NodeSet>>;
+    CFLRGraph::NodeSet none, a, b, ab;
+    a.set(A);
+    b.set(B);
+    ab.set(A);
+    ab.set(B);
+    const std::pair<unsigned, Expected> limits[] = {
+            {2, {{L1, a}, {L2, ab}, {L0, none}, {LS1, a}, {LS2, ab}, {LT, ab}}},
+            {3, {{L1, a}, {L2, b}, {L0, none}, {LS1, a}, {LS2, b}, {LT, a}}}};
+
+    for (auto &limit : limits)
+    {
+        std::vector<Config> all = configs();
+        all.push_back({"worklist/hash", CFLROptions()});
+        for (Config &config : all)
+        {
+            config.options.fieldLimit = limit.first;
+            Solution pts = solve(config.options, NumNodes, [&](CFLR &solver, CFLRStorage storage) {
+                program.build(solver, storage, limit.first, "fields");
+            });
+            bool ok = true;
+            for (auto &node : limit.second)
+                ok = ok && pts[node.first] == node.second;
+            check(ok, config.name + " on fields, limit " + std::to_string(limit.first));
+        }
+    }
+
+    // A grammar set by setGrammar is solved as given, without the field productions
+    CFLROptions options;
+    options.fieldLimit = 2;
+    Solution pts = solve(options, NumNodes, [&](CFLR &solver, CFLRStorage storage) {
+        solver.setGrammar(CFLRGrammar::pointsTo());
+        program.build(solver, storage, 2, "fields");
+    });
+    check(pts[L1].empty() && pts[LS2].empty(), "custom grammar on fields");
+}
+
+/// Every solver on the PAG of a module; LLVM keeps one module per process
+void checkModule(const std::string &module)
+{
+    LLVMModuleSet::buildSVFModule({module});
+    SVFIRBuilder builder;
+    SVFIR *pag = builder.build();
+    unsigned numNodes = pag->getTotalNodeNum();
+    checkSolvers(module, numNodes, [pag](CFLR &solver, CFLRStorage) { solver.buildGraph(pag); });
+
+    // The artifact svfir writes gives the PAG built from the module
+    const std::string artifactFile = "cflr-test.svfir";
+    SVFIRArtifact artifact;
+    artifact.addPAG(pag);
+    check(artifact.save(artifactFile), "saving the artifact of " + module);
+    Solution fromModule = solve(CFLROptions(), numNodes, [pag](CFLR &solver, CFLRStorage) { solver.buildGraph(pag); });
+    Solution fromArtifact = solve(CFLROptions(), numNodes, [&](CFLR &solver, CFLRStorage) {
+        check(solver.loadArtifact(artifactFile), "loading the artifact of " + module);
+    });
+    check(fromArtifact == fromModule, "the artifact of " + module + " against the module");
+    std::remove(artifactFile.c_str());
+    LLVMModuleSet::releaseLLVMModuleSet();
+}
+
+/// An element of FlatWorkList, keyed by itself
+struct Key
+{
+    uint64_t value;
+
+    uint64_t key() const
+    { return value; }
+};
+
+/// FlatWorkList against a deque and a set, with few distinct keys so that probe runs are long and
+/// backward-shift deletion moves entries around
+void checkFlatWorkList()
+{
+    std::mt19937 rng(7);
+    FlatWorkList<Key> list;
+    std::deque<uint64_t> expected;
+    std::set<uint64_t> queued;
+    bool ok = true;
+    for (unsigned step = 0; step < 200000 && ok; ++step)
+    {
+        unsigned action = rng() % 8;
+        if (action < 4 || expected.empty())
+        {
+            uint64_t value = rng() % 512;
+            bool fresh = queued.insert(value).second;
+            ok = list.push(Key{value}) == fresh;
+            if (fresh)
+                expected.push_back(value);
+        }
+        else if (action < 6)
+        {
+            ok = list.pop().value == expected.front();
+            queued.erase(expected.front());
+            expected.pop_front();
+        }
+        else if (action < 7)
+        {
+            ok = list.popBack().value == expected.back();
+            queued.erase(expected.back());
+            expected.pop_back();
+        }
+        else if (rng() % 64 == 0)
+        {
+            list.clear();
+            expected.clear();
+            queued.clear();
+        }
+        ok = ok && list.size() == expected.size();
+    }
+    check(ok, "FlatWorkList against a deque");
+}
+
+/// Whether two grammars have the same tables
+bool sameGrammar(const CFLRGrammar &a, const CFLRGrammar &b)
+{
+    auto sameEntries = [](const std::vector<CFLRGrammar::Entry> &x, const std::vector<CFLRGrammar::Entry> &y) {
+        return std::equal(x.begin(), x.end(), y.begin(), y.end(), [](const auto &e, const auto &f) {
+            return e.other == f.other && e.head == f.head;
+        });
+    };
+    for (EdgeLabel label = 0; label < NumEdgeLabels; ++label)
+        if (a.unary(label) != b.unary(label) || a.inverse(label) != b.inverse(label) ||
+            !sameEntries(a.asLeft(label), b.asLeft(label)) || !sameEntries(a.asRight(label), b.asRight(label)))
+            return false;
+    return std::equal(a.binaries().begin(), a.binaries().end(), b.binaries().begin(), b.binaries().end(),
+                      [](const auto &x, const auto &y) {
+                          return x.head == y.head && x.left == y.left && x.right == y.right;
+                      });
+}
+
+/// Load the given lines as a grammar file
+bool loadGrammar(CFLRGrammar &grammar, const std::string &text)
+{
+    const std::string fileName = "cflr-test.grammar";
+    std::ofstream(fileName) << text;
+    bool loaded = grammar.load(fileName);
+    std::remove(fileName.c_str());
+    return loaded;
+}
+
+/// The points-to grammar written out is loaded back with the same tables, and solves the same
+void checkGrammarLoader()
+{
+    CFLRGrammar loaded;
+    check(loadGrammar(loaded, "# Andersen\n"
+                              "PT -> AddrBar\n"
+                              "PT -> CopyBar PT\n"
+                              "\n"
+                              "PV -> Store PT\n"
+                              "VP -> PTBar Load\n"
+                              "Copy -> PV VP\n"
+                              "inverse PT PTBar\n"
+                              "inverse Copy CopyBar\n"),
+          "loading the points-to grammar");
+    check(sameGrammar(loaded, CFLRGrammar::pointsTo()), "loaded grammar against CFLRGrammar::pointsTo()");
+
+    Program program = randomProgram(120, 200, 99);
+    Solution expected = solve(CFLROptions(), program.numNodes, [&](CFLR &solver, CFLRStorage storage) {
+        program.build(solver, storage, "grammar");
+    });
+    Solution actual = solve(CFLROptions(), program.numNodes, [&](CFLR &solver, CFLRStorage storage) {
+        solver.setGrammar(loaded);
+        program.build(solver, storage, "grammar");
+    });
+    check(actual == expected, "loaded grammar solving a random program");
+
+    CFLRGrammar rejected;
+    check(!loadGrammar(rejected, "PT -> Bogus\n"), "rejecting an unknown label");
+    check(!loadGrammar(rejected, "PT AddrBar\n"), "rejecting a production without arrow");
+    check(!loadGrammar(rejected, "PT -> Copy Copy Copy\n"), "rejecting a production with three symbols");
+    check(!loadGrammar(rejected, "inverse PT\n"), "rejecting an inversion without inverse");
+    check(!rejected.load("cflr-test.missing"), "rejecting a missing file");
+}
+
+/// Removals (DRed) and additions of statements on a solved graph, each batch against a clean solve
+void checkIncremental()
+{
+    std::vector<std::pair<std::string, CFLROptions>> variants(4);
+    variants[0].first = "hash";
+    variants[1].first = "dense";
+    variants[1].second.storage = CFLRStorage::Dense;
+    variants[2].first = "mirrored";
+    variants[2].second.mirrorBars = true;
+    variants[3].first = "scc";
+    variants[3].second.collapseCycles = true;
+
+    for (auto &variant : variants)
+        for (unsigned seed = 1; seed <= 5; ++seed)
+        {
+            std::string name = "incremental/" + variant.first + " on random-" + std::to_string(seed);
+            // Removing a statement removes all its copies, so the program holds each statement once
+            Program random = randomProgram(80, 140, seed);
+            Program program{random.numNodes, {}};
+            for (size_t i = 0; i < random.edges.size(); i += 2)
+                if (std::find(program.edges.begin(), program.edges.end(), random.edges[i]) == program.edges.end())
+                    program.edges.insert(program.edges.end(), random.edges.begin() + i, random.edges.begin() + i + 2);
+            Program extra = randomProgram(80, 40, seed + 100);
+            CFLROptions options = variant.second;
+            options.incremental = true;
+            CFLR solver(options);
+            program.build(solver, options.storage, name);
+            solver.solve();
+
+            // The statements in the graph: each is a pair of edges, the edge and its Bar edge
+            std::vector<CFLREdge> current = program.edges;
+            std::mt19937 rng(seed);
+            bool ok = true;
+            for (unsigned round = 0; round < 6 && ok; ++round)
+            {
+                std::vector<CFLREdge> batch;
+                if (round % 2 == 0)
+                {
+                    for (size_t i = 0; i + 1 < current.size();)
+                        if (rng() % 8 == 0)
+                        {
+                            batch.insert(batch.end(), current.begin() + i, current.begin() + i + 2);
+                            current.erase(current.begin() + i, current.begin() + i + 2);
+                        }
+                        else
+                            i += 2;
+                    ok = solver.removeInitialEdges(batch);
+                }
+                else
+                {
+                    size_t first = (round / 2) * extra.edges.size() / 3 & ~(size_t) 1;
+                    size_t last = (round / 2 + 1) * extra.edges.size() / 3 & ~(size_t) 1;
+                    // Statements already in the graph would be kept once by the solver but twice here
+                    for (size_t i = first; i < last; i += 2)
+                        if (std::find(current.begin(), current.end(), extra.edges[i]) == current.end())
+                            batch.insert(batch.end(), extra.edges.begin() + i, extra.edges.begin() + i + 2);
+                    current.insert(current.end(), batch.begin(), batch.end());
+                    ok = solver.addInitialEdges(batch);
+                }
+
+                Solution expected = solve(CFLROptions(), program.numNodes, [&](CFLR &clean, CFLRStorage storage) {
+                    Program now{program.numNodes, current};
+                    now.build(clean, storage, name);
+                });
+                for (unsigned node = 0; node < program.numNodes && ok; ++node)
+                    ok = solver.pointsTo(node) == expected[node];
+                check(ok, name + ", round " + std::to_string(round));
+                // The demand-driven queries see the updated graph as well
+                for (unsigned node = 0; node < program.numNodes && ok; ++node)
+                {
+                    CFLRGraph::NodeSet pts;
+                    ok = solver.queryPointsTo(node, pts) && pts == expected[node];
+                }
+                check(ok, name + ", round " + std::to_string(round) + ", queried");
+            }
+        }
+}
+
+/// An update file naming each statement once, as the edge or as its Bar edge, gives the sets of a clean solve
+/// of the updated program; a solver that is not incremental, or a malformed line, is rejected
+void checkUpdateFile()
+{
+    const std::string fileName = "cflr-test.update";
+    for (unsigned seed = 1; seed <= 3; ++seed)
+    {
+        Program random = randomProgram(80, 140, seed);
+        Program program{random.numNodes, {}};
+        for (size_t i = 0; i < random.edges.size(); i += 2)
+            if (std::find(program.edges.begin(), program.edges.end(), random.edges[i]) == program.edges.end())
+                program.edges.insert(program.edges.end(), random.edges.begin() + i, random.edges.begin() + i + 2);
+        Program extra = randomProgram(80, 40, seed + 100);
+
+        std::vector<CFLREdge> current = program.edges;
+        std::ofstream out(fileName);
+        auto write = [&out](char kind, const CFLREdge &edge) {
+            out << kind << " " << edge.src << " " << edge.dst << " " << CFLRGrammar::labelName(edge.label) << "\n";
+        };
+        // Removals and additions in turn, each statement named by one of its two edges
+        for (unsigned round = 0; round < 4; ++round)
+            if (round % 2 == 0)
+            {
+                for (size_t i = 2 * round; i + 1 < current.size(); i += 14)
+                {
+                    write('-', current[i + round / 2]);
+                    current.erase(current.begin() + i, current.begin() + i + 2);
+                }
+            }
+            else
+                for (size_t i = (round / 2) * 40; i < (round / 2 + 1) * 40 && i < extra.edges.size(); i += 2)
+                    if (std::find(current.begin(), current.end(), extra.edges[i]) == current.end())
+                    {
+                        write('+', extra.edges[i + i / 2 % 2]);
+                        current.insert(current.end(), extra.edges.begin() + i, extra.edges.begin() + i + 2);
+                    }
+        out.close();
+
+        Solution expected = solve(CFLROptions(), program.numNodes, [&](CFLR &clean, CFLRStorage storage) {
+            Program now{program.numNodes, current};
+            now.build(clean, storage, "updated");
+        });
+        for (CFLRStorage storage : {CFLRStorage::HashMap, CFLRStorage::Dense})
+        {
+            std::string name = std::string("update file/") + (storage == CFLRStorage::Dense ? "dense" : "hash") +
+                               " on random-" + std::to_string(seed);
+            CFLROptions options;
+            options.storage = storage;
+            options.incremental = true;
+            CFLR solver(options);
+            program.build(solver, storage, name);
+            solver.solve();
+            bool ok = solver.applyUpdates(fileName);
+            for (unsigned node = 0; node < program.numNodes && ok; ++node)
+                ok = solver.pointsTo(node) == expected[node];
+            check(ok, name);
+        }
+    }
+
+    CFLR plain;
+    Program program = randomProgram(80, 140, 1);
+    program.build(plain, CFLRStorage::HashMap, "plain");
+    plain.solve();
+    check(!plain.applyUpdates(fileName), "rejecting updates of a solver that is not incremental");
+    std::ofstream(fileName) << "+ 1 2 Copy\n+ 1 2\n";
+    CFLROptions options;
+    options.incremental = true;
+    CFLR solver(options);
+    program.build(solver, CFLRStorage::HashMap, "malformed");
+    solver.solve();
+    check(!solver.applyUpdates(fileName), "rejecting a malformed update");
+    std::remove(fileName.c_str());
+}
+
+/// A snapshot of the initial graph, saved and loaded, solves to the sets of the graph; a snapshot of another key,
+/// truncated, or with a module name longer than the file is rejected
+void checkSnapshot()
+{
+    const std::string fileName = "cflr-test.cflrsnap";
+    Program program = randomProgram(150, 260, 17);
+    Solution expected = solve(CFLROptions(), program.numNodes, [&](CFLR &solver, CFLRStorage storage) {
+        program.build(solver, storage, "cflr-test");
+    });
+    CFLR saver;
+    program.build(saver, CFLRStorage::HashMap, "cflr-test");
+    check(saver.saveSnapshot(fileName, 42), "saving a snapshot");
+
+    for (CFLRStorage storage : {CFLRStorage::HashMap, CFLRStorage::Dense})
+    {
+        CFLROptions options;
+        options.storage = storage;
+        bool loaded = true;
+        Solution pts = solve(options, program.numNodes, [&](CFLR &solver, CFLRStorage) {
+            loaded = solver.loadSnapshot(fileName, 42);
+        });
+        check(loaded && pts == expected, std::string("snapshot round trip, ") +
+                                         (storage == CFLRStorage::Dense ? "dense" : "hash"));
+    }
+    CFLR other;
+    check(!other.loadSnapshot(fileName, 43), "rejecting a snapshot of another key");
+
+    std::string bytes;
+    {
+        std::ifstream in(fileName, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto rejected = [&fileName](const std::string &corrupt) {
+        std::ofstream(fileName, std::ios::binary) << corrupt;
+        CFLR solver;
+        return !solver.loadSnapshot(fileName, 42);
+    };
+    check(rejected(bytes.substr(0, bytes.size() - 1)), "rejecting a truncated snapshot");
+    // A name size whose padding wraps to 0 in 32 bits, without the name: nameSize follows the magic, the
+    // version, the node count, the key and the edge count, and "cflr-test" takes 12 bytes after the header
+    std::string corrupt = bytes.substr(0, 40) + bytes.substr(52);
+    const uint32_t nameSize = ~0u - 1;
+    std::memcpy(&corrupt[32], &nameSize, sizeof(nameSize));
+    check(rejected(corrupt), "rejecting a module name longer than the snapshot");
+    std::remove(fileName.c_str());
+}
+
+/// dumpBinaryResult read back by CFLRResultReader gives the sets and aliases of the solver
+void checkBinaryResult()
+{
+    Program program = randomProgram(150, 260, 42);
+    CFLR solver;
+    program.build(solver, CFLRStorage::HashMap, "cflr-test");
+    solver.solve();
+    solver.dumpBinaryResult();
+
+    CFLRResultReader reader;
+    check(reader.open("cflr-test.res.bin"), "opening the binary result");
+    check(reader.getNodeNum() == program.numNodes, "node count of the binary result");
+    bool sameSets = true;
+    bool sameAliases = true;
+    for (unsigned a = 0; a < program.numNodes; ++a)
+    {
+        const CFLRGraph::NodeSet &pts = solver.pointsTo(a);
+        sameSets = sameSets && reader.pointsTo(a) == std::vector<uint32_t>(pts.begin(), pts.end());
+        for (unsigned b = 0; b < program.numNodes; ++b)
+            sameAliases = sameAliases && reader.mayAlias(a, b) == pts.intersects(solver.pointsTo(b));
+    }
+    check(sameSets, "points-to sets of the binary result");
+    check(sameAliases, "aliases of the binary result");
+    check(reader.pointsTo(program.numNodes + 5).empty(), "node beyond the binary result");
+    reader.close();
+
+    // A truncated file is rejected
+    {
+        std::ifstream in("cflr-test.res.bin", std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream("cflr-test.res.bin", std::ios::binary) << bytes.substr(0, bytes.size() - 1);
+    }
+    check(!reader.open("cflr-test.res.bin"), "rejecting a truncated binary result");
+
+    // Files written by hand: two nodes, the offsets of three and the target lists
+    auto write = [](uint32_t numNodes, uint64_t dataSize, std::vector<uint64_t> offsets, std::vector<uint8_t> data) {
+        CFLRResultHeader header;
+        std::memcpy(header.magic, CFLRResultMagic, sizeof(header.magic));
+        header.version = CFLRResultVersion;
+        header.numNodes = numNodes;
+        header.dataSize = dataSize;
+        std::ofstream out("cflr-test.res.bin", std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(data.data()), data.size());
+    };
+    write(2, 3, {0, 2, 3}, {5, 2, 7});
+    check(reader.open("cflr-test.res.bin") && reader.pointsTo(0) == std::vector<uint32_t>{5, 7} &&
+          reader.pointsTo(1) == std::vector<uint32_t>{7}, "reading a binary result written by hand");
+    write(2, 3, {0, 3, 2}, {5, 2, 7});
+    check(!reader.open("cflr-test.res.bin"), "rejecting decreasing offsets");
+    write(2, 3, {0, 2, 9}, {5, 2, 7});
+    check(!reader.open("cflr-test.res.bin"), "rejecting an offset beyond the data");
+    write(2, 3, {1, 2, 3}, {5, 2, 7});
+    check(!reader.open("cflr-test.res.bin"), "rejecting a first offset beyond the start of the data");
+    write(2, ~0ULL - 15, {0, 2, 3}, {5, 2, 7});
+    check(!reader.open("cflr-test.res.bin"), "rejecting a data size that wraps the file size");
+    write(~0u, 3, {0, 2, 3}, {5, 2, 7});
+    check(!reader.open("cflr-test.res.bin"), "rejecting more offsets than the file holds");
+    write(2, 8, {0, 7, 8}, {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, 4});
+    check(reader.open("cflr-test.res.bin") && reader.pointsTo(0).empty() &&
+          reader.pointsTo(1) == std::vector<uint32_t>{4}, "ending a list at a varint of more than 5 bytes");
+    write(1, 2, {0, 2}, {3, 0x80});
+    check(reader.open("cflr-test.res.bin") && reader.pointsTo(0) == std::vector<uint32_t>{3},
+          "ending a list at an unterminated varint");
+    reader.close();
+    std::remove("cflr-test.res.bin");
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    // The SVF options of svfir, cfga and cflr, so that the PAG is the one they build
+    std::vector<std::string> inputs = SVFIRArtifact::parseOptions(argc, argv, "CFLR checks", "[<input-bitcode>]");
+    if (!inputs.empty())
+        checkModule(inputs[0]);
+    else
+    {
+        checkFlatWorkList();
+        checkGrammarLoader();
+        checkBinaryResult();
+        checkSnapshot();
+        checkIncremental();
+        checkUpdateFile();
+        checkSynthetic();
+        checkFields();
+    }
+
+    if (failures)
+        std::cout << failures << " checks failed\n";
+    return failures ? 1 : 0;
+}
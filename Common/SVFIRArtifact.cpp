@@ -0,0 +1,278 @@
+/**
+ * SVFIRArtifact.cpp
+ * @author kisslune
+ */
+
+#include "SVFIRArtifact.h"
+#include "Graphs/SVFG.h"
+#include "SVF-LLVM/SVFIRBuilder.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+using namespace SVF;
+using namespace llvm;
+using namespace std;
+
+namespace
+{
+
+constexpr unsigned ArtifactVersion = 1;
+
+const char *const StmtNames[] = {"addr", "copy", "store", "load", "gep"};
+const char *const NodeNames[] = {"intra", "entry", "exit", "call", "ret"};
+const char *const EdgeNames[] = {"intra", "call", "ret"};
+
+template<size_t N>
+int indexOf(const char *const (&names)[N], const std::string &name)
+{
+    for (size_t i = 0; i < N; i++)
+        if (name == names[i])
+            return (int) i;
+    return -1;
+}
+
+}
+
+
+std::vector<std::string> SVFIRArtifact::parseOptions(int argc, char **argv, const char *description, const char *usage)
+{
+    // After the options of the command line, so that these win
+    static const char *const PAGOptions[] = {"-model-arrays=true", "-pre-field-sensitive=false", "-model-consts=true",
+                                             "-stat=false"};
+    std::vector<char *> args(argv, argv + argc);
+    for (const char *option : PAGOptions)
+        args.push_back(const_cast<char *>(option));
+    return OptionBase::parseOptions((int) args.size(), args.data(), description, usage);
+}
+
+
+void SVFIRArtifact::addPAG(SVF::SVFIR *pag)
+{
+    module = pag->getModuleIdentifier();
+    numPAGNodes = pag->getTotalNodeNum();
+
+    auto add = [this, pag](StmtKind kind, PAGEdge::PEDGEK edgeKind) {
+        for (PAGEdge *edge : pag->getSVFStmtSet(edgeKind))
+            stmts.push_back({kind, edge->getSrcID(), edge->getDstID(), 0});
+    };
+    add(Addr, PAGEdge::Addr);
+    add(Copy, PAGEdge::Copy);
+    add(Copy, PAGEdge::Call);
+    add(Copy, PAGEdge::Ret);
+    add(Copy, PAGEdge::ThreadFork);
+    add(Copy, PAGEdge::ThreadJoin);
+    add(Store, PAGEdge::Store);
+    add(Load, PAGEdge::Load);
+    for (PAGEdge *edge : pag->getSVFStmtSet(PAGEdge::Phi))
+    {
+        const PhiStmt *phi = SVFUtil::cast<PhiStmt>(edge);
+        for (const auto opVar : phi->getOpndVars())
+            stmts.push_back({Copy, opVar->getId(), phi->getResID(), 0});
+    }
+    for (PAGEdge *edge : pag->getSVFStmtSet(PAGEdge::Select))
+    {
+        const SelectStmt *select = SVFUtil::cast<SelectStmt>(edge);
+        for (const auto opVar : select->getOpndVars())
+            stmts.push_back({Copy, opVar->getId(), select->getResID(), 0});
+    }
+    for (PAGEdge *edge : pag->getSVFStmtSet(PAGEdge::Gep))
+    {
+        const GepStmt *gep = SVFUtil::cast<GepStmt>(edge);
+        int64_t field = gep->isConstantOffset() ? (int64_t) gep->getConstantStructFldIdx() : VariantField;
+        stmts.push_back({Gep, edge->getSrcID(), edge->getDstID(), field});
+    }
+}
+
+
+void SVFIRArtifact::addICFG(SVF::ICFG *icfg)
+{
+    std::unordered_map<std::string, unsigned> funIds;
+    auto funId = [&](const std::string &name) {
+        auto it = funIds.emplace(name, (unsigned) funs.size());
+        if (it.second)
+            funs.push_back(name);
+        return it.first->second;
+    };
+
+    for (auto &it : *icfg)
+    {
+        const ICFGNode *node = it.second;
+        Node rec{it.first, Intra, funId(node->getFun() ? node->getFun()->getName() : ""), 0};
+        if (isa<FunEntryICFGNode>(node))
+            rec.kind = FunEntry;
+        else if (isa<FunExitICFGNode>(node))
+            rec.kind = FunExit;
+        else if (isa<CallICFGNode>(node))
+            rec.kind = FunCall;
+        else if (auto retNode = dyn_cast<RetICFGNode>(node))
+        {
+            rec.kind = FunRet;
+            rec.callNode = retNode->getCallICFGNode()->getId();
+        }
+        nodes.push_back(rec);
+
+        for (auto edge : node->getOutEdges())
+        {
+            EdgeKind kind = isa<CallCFGEdge>(edge) ? CallCF : isa<RetCFGEdge>(edge) ? RetCF : IntraCF;
+            edges.push_back({kind, edge->getSrcID(), edge->getDstID()});
+        }
+    }
+}
+
+
+bool SVFIRArtifact::save(const std::string &fname) const
+{
+    std::ofstream outFile(fname, std::ios::out);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return false;
+    }
+
+    outFile << "svfir-artifact " << ArtifactVersion << "\n";
+    outFile << "module " << module << "\n";
+    outFile << "pag " << numPAGNodes << "\n";
+    for (auto &stmt : stmts)
+    {
+        outFile << StmtNames[stmt.kind] << ' ' << stmt.src << ' ' << stmt.dst;
+        if (stmt.kind == Gep)
+        {
+            if (stmt.field == VariantField)
+                outFile << " *";
+            else
+                outFile << ' ' << stmt.field;
+        }
+        outFile << "\n";
+    }
+    for (size_t i = 0; i < funs.size(); i++)
+        outFile << "fun " << i << ' ' << funs[i] << "\n";
+    for (auto &node : nodes)
+    {
+        outFile << "node " << node.id << ' ' << NodeNames[node.kind] << ' ' << node.fun;
+        if (node.kind == FunRet)
+            outFile << ' ' << node.callNode;
+        outFile << "\n";
+    }
+    for (auto &edge : edges)
+        outFile << "edge " << EdgeNames[edge.kind] << ' ' << edge.src << ' ' << edge.dst << "\n";
+
+    outFile.close();
+    return (bool) outFile;
+}
+
+
+bool SVFIRArtifact::load(const std::string &fname)
+{
+    std::ifstream inFile(fname);
+    if (!inFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return false;
+    }
+
+    std::string line, word;
+    unsigned version = 0;
+    if (!std::getline(inFile, line) || std::sscanf(line.c_str(), "svfir-artifact %u", &version) != 1 ||
+        version != ArtifactVersion)
+    {
+        std::cout << fname + " is not an SVFIR artifact of version " + std::to_string(ArtifactVersion) + "!!\n";
+        return false;
+    }
+
+    for (unsigned lineNo = 2; std::getline(inFile, line); lineNo++)
+    {
+        std::istringstream fields(line);
+        if (!(fields >> word))
+            continue;
+        bool ok = true;
+        if (word == "module")
+        {
+            std::getline(fields >> std::ws, module);
+        }
+        else if (word == "pag")
+            ok = (bool) (fields >> numPAGNodes);
+        else if (word == "fun")
+        {
+            size_t index;
+            std::string name;
+            ok = (bool) (fields >> index) && index == funs.size();
+            std::getline(fields >> std::ws, name);
+            funs.push_back(name);
+        }
+        else if (word == "node")
+        {
+            Node node{0, Intra, 0, 0};
+            int kind = -1;
+            ok = (bool) (fields >> node.id >> word >> node.fun) && (kind = indexOf(NodeNames, word)) >= 0;
+            node.kind = (NodeKind) kind;
+            if (ok && node.kind == FunRet)
+                ok = (bool) (fields >> node.callNode);
+            nodes.push_back(node);
+        }
+        else if (word == "edge")
+        {
+            Edge edge{IntraCF, 0, 0};
+            int kind = -1;
+            ok = (bool) (fields >> word >> edge.src >> edge.dst) && (kind = indexOf(EdgeNames, word)) >= 0;
+            edge.kind = (EdgeKind) kind;
+            edges.push_back(edge);
+        }
+        else
+        {
+            Stmt stmt{Addr, 0, 0, 0};
+            int kind = indexOf(StmtNames, word);
+            ok = kind >= 0 && (bool) (fields >> stmt.src >> stmt.dst);
+            stmt.kind = (StmtKind) kind;
+            if (ok && stmt.kind == Gep)
+            {
+                ok = (bool) (fields >> word);
+                if (ok && word == "*")
+                    stmt.field = VariantField;
+                else if (ok)
+                {
+                    const char *end = word.data() + word.size();
+                    auto parsed = std::from_chars(word.data(), end, stmt.field);
+                    ok = parsed.ec == std::errc() && parsed.ptr == end;
+                }
+            }
+            stmts.push_back(stmt);
+        }
+        if (!ok)
+        {
+            std::cout << fname + ":" + std::to_string(lineNo) + ": malformed record!!\n";
+            return false;
+        }
+    }
+
+    // Records may come in any order, so the ids they refer to are checked once all are read
+    auto isNode = [this](unsigned id) {
+        auto it = std::lower_bound(nodes.begin(), nodes.end(), id, [](const Node &n, unsigned i) { return n.id < i; });
+        return it != nodes.end() && it->id == id;
+    };
+    std::string error;
+    for (size_t i = 0; i < stmts.size() && error.empty(); i++)
+        if (stmts[i].src >= numPAGNodes || stmts[i].dst >= numPAGNodes)
+            error = "statement " + std::to_string(i) + " refers to a PAG node beyond " + std::to_string(numPAGNodes);
+    for (size_t i = 0; i < nodes.size() && error.empty(); i++)
+        if (nodes[i].fun >= funs.size())
+            error = "ICFG node " + std::to_string(nodes[i].id) + " is in a missing function";
+    for (size_t i = 1; i < nodes.size() && error.empty(); i++)
+        if (nodes[i].id <= nodes[i - 1].id)
+            error = "ICFG node " + std::to_string(nodes[i].id) + " is out of order";
+    for (size_t i = 0; i < nodes.size() && error.empty(); i++)
+        if (nodes[i].kind == FunRet && !isNode(nodes[i].callNode))
+            error = "ICFG node " + std::to_string(nodes[i].id) + " returns to a missing call node";
+    for (size_t i = 0; i < edges.size() && error.empty(); i++)
+        if (!isNode(edges[i].src) || !isNode(edges[i].dst))
+            error = "ICFG edge " + std::to_string(i) + " connects a missing node";
+    if (!error.empty())
+    {
+        std::cout << fname + ": " + error + "!!\n";
+        return false;
+    }
+    return true;
+}
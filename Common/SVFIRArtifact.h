@@ -0,0 +1,90 @@
+/**
+ * SVFIRArtifact.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_SVFIR_ARTIFACT_H
+#define ANSWERS_SVFIR_ARTIFACT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SVF
+{
+class SVFIR;
+class ICFG;
+}
+
+/**
+ * The PAG and the ICFG of a module, written once by svfir and loaded by cfga and cflr
+ * without building the module again. Text, one record per line:
+ *   svfir-artifact <version>
+ *   module <name>
+ *   pag <number of PAG nodes>
+ *   addr|copy|store|load <src> <dst>
+ *   gep <src> <dst> <field index, or * for a variable offset>
+ *   fun <index> <name>
+ *   node <id> intra|entry|exit|call|ret <fun index> [<call node, for ret>]
+ *   edge intra|call|ret <src> <dst>
+ * Copy also stands for the operands of Phi and Select, and for Call, Ret, ThreadFork and ThreadJoin.
+ */
+struct SVFIRArtifact
+{
+    enum StmtKind : uint8_t
+    {
+        Addr, Copy, Store, Load, Gep
+    };
+    enum NodeKind : uint8_t
+    {
+        Intra, FunEntry, FunExit, FunCall, FunRet
+    };
+    enum EdgeKind : uint8_t
+    {
+        IntraCF, CallCF, RetCF
+    };
+    static constexpr int64_t VariantField = -1;
+
+    struct Stmt
+    {
+        StmtKind kind;
+        unsigned src;
+        unsigned dst;
+        int64_t field;      ///< Gep only
+    };
+
+    struct Node
+    {
+        unsigned id;
+        NodeKind kind;
+        unsigned fun;       ///< index into funs; nodes outside any function have the empty name
+        unsigned callNode;  ///< FunRet only
+    };
+
+    struct Edge
+    {
+        EdgeKind kind;
+        unsigned src;
+        unsigned dst;
+    };
+
+    std::string module;
+    unsigned numPAGNodes = 0;
+    std::vector<Stmt> stmts;
+    std::vector<std::string> funs;
+    std::vector<Node> nodes;    ///< in ascending id order
+    std::vector<Edge> edges;    ///< grouped by source, each node's out-edges in ICFG order
+
+    void addPAG(SVF::SVFIR *pag);
+    void addICFG(SVF::ICFG *icfg);
+
+    /// Parses the command line of a tool that builds a PAG, svfir included, together with the SVF options they all
+    /// share, so that the PAG of an artifact is the one cfga and cflr would build from the module.  Returns the inputs
+    static std::vector<std::string> parseOptions(int argc, char **argv, const char *description, const char *usage);
+
+    bool save(const std::string &fname) const;
+    /// Returns false on a malformed record, or a statement, edge or return node referring to a missing node
+    bool load(const std::string &fname);
+};
+
+#endif //ANSWERS_SVFIR_ARTIFACT_H